@@ -0,0 +1,31 @@
+-- ns/access of the closures returned by getter and setter, against buf[i]
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+
+for _, type in ipairs {'uchar', 'int', 'double', 'be32'} do
+	local buf=buffer2.calloc(N, type)
+	local get, set=buf:getter(), buf:setter()
+	bench.title(type)
+	
+	local read=bench.run('get(i)', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+get(i) end
+		return sum
+	end, 'access')
+	local readIndex=bench.run('buf[i]', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+buf[i] end
+		return sum
+	end, 'access')
+	bench.speedup('read speedup', readIndex, read)
+	
+	local write=bench.run('set(i, v)', N, function(n)
+		for i=1, n do set(i, i%100) end
+	end, 'access')
+	local writeIndex=bench.run('buf[i]=v', N, function(n)
+		for i=1, n do buf[i]=i%100 end
+	end, 'access')
+	bench.speedup('write speedup', writeIndex, write)
+end
@@ -0,0 +1,34 @@
+-- allocation rate and GC pause of inline buffers, against buffers with their own allocation
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local COUNT=100000
+local inline={inline=true}
+
+for _, size in ipairs {16, 256, 4096} do
+	bench.title(size..' bytes')
+	
+	-- the collector runs as usual, so its work is part of the time per buffer
+	local rateInline=bench.run('buffer2.new(size, {inline=true})', COUNT, function(n)
+		for _=1, n do buffer2.new(size, inline) end
+	end, 'buffer')
+	local rate=bench.run('buffer2.new(size)', COUNT, function(n)
+		for _=1, n do buffer2.new(size) end
+	end, 'buffer')
+	bench.speedup('allocation speedup', rate, rateInline)
+	
+	-- time a full collection of COUNT dead buffers, and report the memory the collector saw them use
+	for _, options in ipairs {inline, false} do
+		local name=options and 'inline' or 'separate'
+		collectgarbage 'collect'
+		local before=collectgarbage 'count'
+		local bufs={}
+		for k=1, COUNT do bufs[k]=buffer2.new(size, options or nil) end
+		local seen=collectgarbage 'count'-before
+		bufs=nil
+		local start=os.clock()
+		collectgarbage 'collect'
+		local pause=os.clock()-start
+		print(string.format('  %-40s %12.2f ms, %.0f KiB seen by the GC', 'GC pause, '..name, pause*1e3, seen))
+	end
+end
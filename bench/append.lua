@@ -0,0 +1,30 @@
+-- ns/append and MB/s of growing a buffer by 16 bytes at a time, for several growth factors
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+local CHUNK=string.rep('x', 16)
+
+-- appends n chunks to a new buffer, like a serializer would
+local function append(n)
+	local buf=buffer2.new(#CHUNK)
+	local size=0
+	for _=1, n do
+		buf.size=size+#CHUNK
+		buf:writestring(CHUNK, 1, -1, size+1)
+		size=size+#CHUNK
+	end
+	return buf
+end
+
+local default=buffer2.getgrowth()
+bench.title(N..' appends of '..#CHUNK..' bytes')
+local times={}
+for _, factor in ipairs {1, 1.5, 2} do
+	buffer2.setgrowth(factor)
+	local ns=bench.run('growth factor '..factor, N, append, 'append')
+	print(string.format('  %-40s %12.1f MB/s', '', #CHUNK*1e3/ns))
+	times[factor]=ns
+end
+buffer2.setgrowth(default)
+bench.speedup('1.5 over exact sizing', times[1], times[1.5])
@@ -0,0 +1,56 @@
+-- helpers shared by the benchmarks, which are run from the root of the repo by `make bench`
+local bench={}
+
+-- the number of elements most benchmarks work on
+bench.N=tonumber(os.getenv 'BENCH_N') or 1000000
+
+-- the minimum CPU time a measure runs for, in seconds
+local MIN_TIME=0.2
+
+-- prints the name of a group of benchmarks
+function bench.title(title)
+	print()
+	print(title)
+end
+
+-- calls fn(n) once to warm up, then until it has run for MIN_TIME, and returns the time per unit in ns
+function bench.measure(fn, n)
+	fn(n)
+	local runs, start=0, os.clock()
+	local elapsed
+	repeat
+		fn(n)
+		runs=runs+1
+		elapsed=os.clock()-start
+	until elapsed>=MIN_TIME
+	return elapsed*1e9/(runs*n)
+end
+
+-- calls fn() for whole seconds of wall clock time, and returns the time per call in ns
+-- os.clock counts the CPU time of every thread, so this is what shows the speedup of multithreaded operations
+-- os.time only counts seconds, so the calls start on a new second, and the error is at most one call
+function bench.wall(fn, seconds)
+	fn()
+	local tick=os.time()
+	repeat until os.time()~=tick
+	local stop, calls=os.time()+(seconds or 1), 0
+	repeat
+		fn()
+		calls=calls+1
+	until os.time()>=stop
+	return (seconds or 1)*1e9/calls
+end
+
+-- measures fn(n) and prints the time per unit, which is an element by default
+function bench.run(name, n, fn, unit)
+	local ns=bench.measure(fn, n)
+	print(string.format('  %-40s %12.2f ns/%s', name, ns, unit or 'element'))
+	return ns
+end
+
+-- prints how many times faster the second time is
+function bench.speedup(name, before, after)
+	print(string.format('  %-40s %12.2fx', name, before/after))
+end
+
+return bench
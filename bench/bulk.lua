@@ -0,0 +1,38 @@
+-- ns/element of totable, fromtable and setrange, against the per-element loops of examples/example.lua
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+local unpack=table.unpack or unpack
+
+for _, type in ipairs {'short', 'int', 'double'} do
+	local buf=buffer2.calloc(N, type)
+	local values={}
+	for i=1, N do values[i]=i%100 end
+	bench.title(type)
+	
+	local read=bench.run('buf:totable()', N, function()
+		return buf:totable()
+	end)
+	local readLoop=bench.run('t[i]=buf[i]', N, function(n)
+		local t={}
+		for i=1, n do t[i]=buf[i] end
+		return t
+	end)
+	bench.speedup('read speedup', readLoop, read)
+	
+	local write=bench.run('buf:fromtable(t)', N, function()
+		buf:fromtable(values)
+	end)
+	local writeLoop=bench.run('buf[i]=t[i]', N, function(n)
+		for i=1, n do buf[i]=values[i] end
+	end)
+	bench.speedup('write speedup', writeLoop, write)
+	
+	-- setrange takes its values as arguments, so they are written in chunks which fit on the stack
+	local CHUNK=64
+	local chunk={unpack(values, 1, CHUNK)}
+	bench.run('buf:setrange(i, ...) by '..CHUNK, N, function(n)
+		for i=1, n-CHUNK+1, CHUNK do buf:setrange(i, unpack(chunk)) end
+	end)
+end
@@ -0,0 +1,42 @@
+-- throughput of copy, internalcopy and clone, on small buffers where the call dominates and on large ones where memory bandwidth does
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+
+-- small copies are measured per call
+local SMALL=64
+local src, dst=buffer2.calloc(SMALL, 'char'), buffer2.calloc(SMALL, 'char')
+local buf=buffer2.calloc(2*SMALL, 'char')
+bench.title(SMALL..' bytes')
+bench.run('src:copy(dst)', N, function(n)
+	for _=1, n do src:copy(dst) end
+end, 'call')
+bench.run('buf:internalcopy(1, len, len/2)', N, function(n)
+	for _=1, n do buf:internalcopy(1, SMALL, SMALL/2+1) end
+end, 'call')
+bench.run('src:clone()', N, function(n)
+	for _=1, n do src:clone() end
+end, 'call')
+
+-- large copies are measured per byte, and reported in GB/s
+local LARGE=64*1024*1024
+src, dst=buffer2.calloc(LARGE, 'char'), buffer2.calloc(LARGE, 'char')
+buf=buffer2.calloc(LARGE+4096, 'char')
+local function report(name, fn)
+	local ns=bench.run(name, LARGE, fn, 'byte')
+	print(string.format('  %-40s %12.2f GB/s', '', 1/ns))
+end
+bench.title(LARGE..' bytes')
+report('src:copy(dst)', function()
+	src:copy(dst)
+end)
+report('buf:internalcopy(1, len, 4097), overlapping', function()
+	buf:internalcopy(1, LARGE, 4097)
+end)
+-- clones include the allocation and the page faults of the new buffer
+-- the collector doesn't see the memory of the clones, so they are collected right away instead of piling up
+report('src:clone()', function()
+	src:clone()
+	collectgarbage()
+end)
@@ -0,0 +1,40 @@
+-- ns/access of random reads over a large buffer, with and without huge pages, where TLB misses dominate
+-- BENCH_HUGE_MIB sets the size of the buffers, 1024 by default, and the random reads go through a getter to keep the call cheap
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+local SIZE=(tonumber(os.getenv 'BENCH_HUGE_MIB') or 1024)*1024*1024
+local LENGTH=SIZE//4
+
+-- reads the huge pages currently backing the process, where the kernel reports them
+local function hugePages()
+	local file=io.open('/proc/self/smaps_rollup')
+	if not file then return '?' end
+	local kb=file:read('a'):match('AnonHugePages:%s*(%d+)')
+	file:close()
+	return kb and (kb//1024)..' MiB' or '?'
+end
+
+bench.title((SIZE//1048576)..' MiB, random 4 byte reads')
+local times={}
+for _, hugepage in ipairs {false, true} do
+	local buf=buffer2.calloc(LENGTH, 'int', {hugepage=hugepage})
+	-- touch every page, so that page faults aren't measured
+	buf:fill(1)
+	local get=buf:getter()
+	local name=hugepage and 'hugepage=true' or 'plain'
+	times[hugepage]=bench.run(name, N, function(n)
+		local x, sum=12345, 0
+		for _=1, n do
+			x=x*6364136223846793005+1442695040888963407
+			sum=sum+get((x>>33)%LENGTH+1)
+		end
+		return sum
+	end, 'access')
+	print(string.format('  %-40s %12s', 'huge pages in use', hugePages()))
+	buf=nil
+	get=nil
+	collectgarbage()
+end
+bench.speedup('huge page speedup', times[false], times[true])
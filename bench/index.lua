@@ -0,0 +1,43 @@
+-- ns/element of reads and writes through __index and __newindex, against buffer2.get and buffer2.set which check the buffer and its type
+-- the closures returned by getter and setter are bound to their buffer, and show the cost of recognizing buffers by their metatable in the fast path
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+local get, set=buffer2.get, buffer2.set
+
+for _, type in ipairs {'uchar', 'int', 'double'} do
+	local buf=buffer2.calloc(N, type)
+	local bufGet, bufSet=buf:getter(), buf:setter()
+	bench.title(type)
+	
+	local read=bench.run('buf[i]', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+buf[i] end
+		return sum
+	end)
+	local readCall=bench.run('buffer2.get(buf, i)', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+get(buf, i) end
+		return sum
+	end)
+	bench.speedup('read speedup', readCall, read)
+	local readBound=bench.run('get(i), without metatable check', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+bufGet(i) end
+		return sum
+	end)
+	bench.speedup('read check overhead', read, readBound)
+	
+	local write=bench.run('buf[i]=v', N, function(n)
+		for i=1, n do buf[i]=i%100 end
+	end)
+	local writeCall=bench.run('buffer2.set(buf, i, v)', N, function(n)
+		for i=1, n do set(buf, i, i%100) end
+	end)
+	bench.speedup('write speedup', writeCall, write)
+	local writeBound=bench.run('set(i, v), without metatable check', N, function(n)
+		for i=1, n do bufSet(i, i%100) end
+	end)
+	bench.speedup('write check overhead', write, writeBound)
+end
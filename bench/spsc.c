@@ -0,0 +1,194 @@
+// throughput and latency of buffer_spsc_t between two threads, against a ring guarded by a mutex
+// build and run it with `make bench`, on a machine with at least two cores for meaningful numbers
+// usage: bench/spsc [MiB streamed, 256 by default] [round trips, 1000000 by default]
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "buffer2.h"
+
+#define CAPACITY (1<<20)
+
+// one side of a transfer, streaming total bytes in batches of at most batch bytes
+typedef struct {
+	buffer_spsc_t* queue;
+	size_t total;
+	buffer_size_t batch;
+	size_t errors;
+} stream_t;
+
+// a circular buffer guarded by a mutex, the usual alternative to a lock-free queue
+typedef struct {
+	pthread_mutex_t lock;
+	char* data;
+	size_t head;
+	size_t tail;
+	size_t total;
+	buffer_size_t batch;
+	size_t errors;
+} locked_t;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+// spins while waiting for the other thread, but lets it run when both share a core
+static void idle(unsigned* spins) {
+	if(++*spins%1024==0) sched_yield();
+}
+
+static void* produce(void* arg) {
+	stream_t* run=(stream_t*) arg;
+	unsigned char next=0;
+	unsigned spins=0;
+	for(size_t sent=0; sent<run->total;) {
+		buffer_size_t len=run->batch;
+		unsigned char* p=(unsigned char*) buffer_spscReserve(run->queue, &len);
+		if(len==0) {
+			idle(&spins);
+			continue;
+		}
+		if(len>run->batch) len=run->batch;
+		if((size_t) len>run->total-sent) len=run->total-sent;
+		for(buffer_size_t k=0; k<len; k++) p[k]=next++;
+		buffer_spscCommit(run->queue, len);
+		sent+=len;
+	}
+	return NULL;
+}
+
+static void consume(stream_t* run) {
+	unsigned char expected=0;
+	unsigned spins=0;
+	for(size_t received=0; received<run->total;) {
+		buffer_size_t len=run->batch;
+		const unsigned char* p=(const unsigned char*) buffer_spscPeek(run->queue, &len);
+		if(len==0) {
+			idle(&spins);
+			continue;
+		}
+		if(len>run->batch) len=run->batch;
+		for(buffer_size_t k=0; k<len; k++) run->errors+=p[k]!=expected++;
+		buffer_spscConsume(run->queue, len);
+		received+=len;
+	}
+}
+
+static void* produceLocked(void* arg) {
+	locked_t* run=(locked_t*) arg;
+	unsigned char* chunk=(unsigned char*) malloc(run->batch);
+	unsigned char next=0;
+	unsigned spins=0;
+	for(size_t sent=0; sent<run->total;) {
+		size_t len=run->batch;
+		if(len>run->total-sent) len=run->total-sent;
+		for(size_t k=0; k<len; k++) chunk[k]=next+k;
+		
+		pthread_mutex_lock(&run->lock);
+		size_t room=CAPACITY-(run->tail-run->head);
+		if(len>room) len=room;
+		size_t off=run->tail%CAPACITY, first=len<CAPACITY-off?len:CAPACITY-off;
+		memcpy(run->data+off, chunk, first);
+		memcpy(run->data, chunk+first, len-first);
+		run->tail+=len;
+		pthread_mutex_unlock(&run->lock);
+		
+		if(len==0) idle(&spins);
+		next+=len;
+		sent+=len;
+	}
+	free(chunk);
+	return NULL;
+}
+
+static void consumeLocked(locked_t* run) {
+	unsigned char* chunk=(unsigned char*) malloc(run->batch);
+	unsigned char expected=0;
+	unsigned spins=0;
+	for(size_t received=0; received<run->total;) {
+		pthread_mutex_lock(&run->lock);
+		size_t len=run->tail-run->head;
+		if(len>(size_t) run->batch) len=run->batch;
+		size_t off=run->head%CAPACITY, first=len<CAPACITY-off?len:CAPACITY-off;
+		memcpy(chunk, run->data+off, first);
+		memcpy(chunk+first, run->data, len-first);
+		run->head+=len;
+		pthread_mutex_unlock(&run->lock);
+		
+		if(len==0) idle(&spins);
+		for(size_t k=0; k<len; k++) run->errors+=chunk[k]!=expected++;
+		received+=len;
+	}
+	free(chunk);
+}
+
+// the echo side of the latency test, sending back every message it receives
+typedef struct {
+	buffer_spsc_t* ping;
+	buffer_spsc_t* pong;
+	long rounds;
+} echo_t;
+
+static void* echo(void* arg) {
+	echo_t* run=(echo_t*) arg;
+	uint64_t msg;
+	unsigned spins=0;
+	for(long k=0; k<run->rounds; k++) {
+		while(buffer_spscPop(run->ping, &msg, sizeof(msg))==0) idle(&spins);
+		while(buffer_spscPush(run->pong, &msg, sizeof(msg))==0) idle(&spins);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv) {
+	size_t total=(argc>1?strtoul(argv[1], NULL, 10):256)<<20;
+	long rounds=argc>2?strtol(argv[2], NULL, 10):1000000;
+	static const buffer_size_t batches[]={64, 4096, 65536};
+	pthread_t thread;
+	
+	printf("streaming %zu MiB through a %d KiB queue\n", total>>20, CAPACITY>>10);
+	for(size_t b=0; b<sizeof(batches)/sizeof(batches[0]); b++) {
+		stream_t run={buffer_spscCreate(CAPACITY), total, batches[b], 0};
+		if(run.queue==NULL) return EXIT_FAILURE;
+		double start=now();
+		pthread_create(&thread, NULL, produce, &run);
+		consume(&run);
+		pthread_join(thread, NULL);
+		double elapsed=now()-start;
+		printf("  spsc, %6lu B batches   %8.2f GB/s, %zu errors\n", (unsigned long) batches[b], total/elapsed*1e-9, run.errors);
+		buffer_spscDestroy(run.queue);
+		
+		locked_t locked={PTHREAD_MUTEX_INITIALIZER, (char*) malloc(CAPACITY), 0, 0, total, batches[b], 0};
+		start=now();
+		pthread_create(&thread, NULL, produceLocked, &locked);
+		consumeLocked(&locked);
+		pthread_join(thread, NULL);
+		elapsed=now()-start;
+		printf("  mutex, %6lu B batches  %8.2f GB/s, %zu errors\n", (unsigned long) batches[b], total/elapsed*1e-9, locked.errors);
+		free(locked.data);
+	}
+	
+	printf("%ld round trips of 8 bytes\n", rounds);
+	echo_t run={buffer_spscCreate(64), buffer_spscCreate(64), rounds};
+	if(run.ping==NULL||run.pong==NULL) return EXIT_FAILURE;
+	uint64_t msg=0;
+	unsigned spins=0;
+	double start=now();
+	pthread_create(&thread, NULL, echo, &run);
+	for(long k=0; k<rounds; k++) {
+		while(buffer_spscPush(run.ping, &msg, sizeof(msg))==0) idle(&spins);
+		while(buffer_spscPop(run.pong, &msg, sizeof(msg))==0) idle(&spins);
+		msg++;
+	}
+	pthread_join(thread, NULL);
+	printf("  spsc round trip          %8.1f ns\n", (now()-start)*1e9/rounds);
+	buffer_spscDestroy(run.ping);
+	buffer_spscDestroy(run.pong);
+	
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+-- MB/s of fromstring, readstring and writestring on large strings, against copying one byte per call
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local byte, char=string.byte, string.char
+
+-- ns/byte to MB/s
+local function report(name, ns)
+	print(string.format('  %-40s %12.1f MB/s', name, 1e3/ns))
+end
+
+for _, size in ipairs {64*1024, 1024*1024, 16*1024*1024} do
+	local str=string.rep('0123456789abcdef', size/16)
+	local buf=buffer2.fromstring(str)
+	bench.title(size..' bytes')
+	
+	report('buffer2.fromstring(str)', bench.run('buffer2.fromstring(str)', size, function()
+		return buffer2.fromstring(str)
+	end, 'byte'))
+	report('buf:readstring()', bench.run('buf:readstring()', size, function()
+		return buf:readstring()
+	end, 'byte'))
+	report('buf:writestring(str)', bench.run('buf:writestring(str)', size, function()
+		buf:writestring(str)
+	end, 'byte'))
+end
+
+-- the per-byte loops are only measured on the smallest size, as they are orders of magnitude slower
+local size=64*1024
+local str=string.rep('0123456789abcdef', size/16)
+local buf=buffer2.calloc(size, 'uchar')
+bench.title(size..' bytes, one byte per call')
+report('buf[i]=str:byte(i)', bench.run('buf[i]=str:byte(i)', size, function(n)
+	for i=1, n do buf[i]=byte(str, i) end
+end, 'byte'))
+report('table.concat of char(buf[i])', bench.run('table.concat of char(buf[i])', size, function(n)
+	local t={}
+	for i=1, n do t[i]=char(buf[i]) end
+	return table.concat(t)
+end, 'byte'))
@@ -0,0 +1,35 @@
+-- wall clock scaling of sum, fill and copy over large buffers, from 1 thread to BENCH_THREADS, which defaults to the number of cores
+-- each measure takes 2 to 3 seconds
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local LENGTH=16*1024*1024
+
+local function cores()
+	local pipe=io.popen('nproc 2>/dev/null')
+	local count=pipe and tonumber(pipe:read('a'))
+	if pipe then pipe:close() end
+	return count or 4
+end
+local MAX=tonumber(os.getenv 'BENCH_THREADS') or cores()
+
+local floats=buffer2.calloc(LENGTH, 'float')
+floats:fill(1)
+local src, dst=buffer2.calloc(4*LENGTH, 'char'), buffer2.calloc(4*LENGTH, 'char')
+local ops={
+	{'sum of '..LENGTH..' floats', function() return floats:sum() end},
+	{'fill of '..LENGTH..' floats', function() floats:fill(2) end},
+	{'copy of '..(4*LENGTH)..' bytes', function() src:copy(dst) end},
+}
+
+for _, op in ipairs(ops) do
+	bench.title(op[1])
+	local single
+	for threads=1, MAX do
+		local actual=buffer2.setthreads(threads)
+		local ns=bench.wall(op[2], 2)
+		single=single or ns
+		print(string.format('  %-40s %12.3f ms/op %8.2fx', actual..' threads', ns*1e-6, single/ns))
+	end
+end
+buffer2.setthreads(1)
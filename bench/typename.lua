@@ -0,0 +1,37 @@
+-- ns/call of get and set with a type given by name, against the same type given as an integer
+local buffer2=require 'buffer2'
+local bench=require 'bench'
+
+local N=bench.N
+
+for _, name in ipairs {'int32', 'unsigned long long', 'double'} do
+	local buf=buffer2.calloc(N, name)
+	-- the integer representation of the type, as returned by gettype
+	local code=buf.type
+	bench.title(name)
+	
+	local byName=bench.run('buf:get(i, name)', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+buf:get(i, name) end
+		return sum
+	end, 'call')
+	local byCode=bench.run('buf:get(i, code)', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+buf:get(i, code) end
+		return sum
+	end, 'call')
+	bench.run('buf:get(i)', N, function(n)
+		local sum=0
+		for i=1, n do sum=sum+buf:get(i) end
+		return sum
+	end, 'call')
+	bench.speedup('name/integer ratio', byName, byCode)
+	
+	byName=bench.run('buf:set(i, v, name)', N, function(n)
+		for i=1, n do buf:set(i, i%100, name) end
+	end, 'call')
+	byCode=bench.run('buf:set(i, v, code)', N, function(n)
+		for i=1, n do buf:set(i, i%100, code) end
+	end, 'call')
+	bench.speedup('name/integer ratio', byName, byCode)
+end
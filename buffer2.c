@@ -1,8 +1,34 @@
+// memfd_create, used to map ring buffers twice
+#if defined(__linux__)&&!defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "buffer2.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#if defined(__unix__)||defined(__APPLE__)
+#define BUFFER_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__unix__)||defined(__APPLE__)
+#define BUFFER_HAS_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__GNUC__)&&defined(__x86_64__)
+#define BUFFER_X86_SIMD
+#include <immintrin.h>
+#endif
 
-buffer_t *buffer_allocData(void* buffer, int size, int destroy) {
+buffer_t *buffer_allocData(void* buffer, buffer_size_t size, int destroy) {
 	buffer_t *buf=(buffer_t*) buffer;
 	
 	if(buf==NULL) return NULL;
@@ -10,6 +36,7 @@ buffer_t *buffer_allocData(void* buffer, int size, int destroy) {
 	buf->size=size;
 	buf->alloc=size;
 	buf->user=0;
+	buf->flags=0;
 	buf->ptr=malloc(size);
 	
 	if(buf->ptr==NULL) {
@@ -21,14 +48,112 @@ buffer_t *buffer_allocData(void* buffer, int size, int destroy) {
 	return buf;
 }
 
-buffer_t *buffer_callocData(void* buffer, int length, int elem, int destroy) {
+buffer_t *buffer_allocInline(buffer_size_t size) {
+	if((size_t) size>BUFFER_SIZE_MAX-sizeof(buffer_t)) return NULL;
+	
+	void *mem=malloc(sizeof(buffer_t)+size);
+	if(mem==NULL) return NULL;
+	
+	return buffer_inlineData(mem, size);
+}
+
+buffer_t *buffer_inlineData(void* buf, buffer_size_t size) {
+	buffer_t *buffer=(buffer_t*) buf;
+	
+	buffer->size=size;
+	buffer->alloc=size;
+	buffer->user=0;
+	buffer->flags=BUFFER_INLINE;
+	buffer->ptr=buffer+1;
+	
+	return buffer;
+}
+
+// transparent huge pages are 2 MiB on systems with 4 KiB pages
+#define HUGE_PAGE_SIZE ((buffer_size_t) 2<<20)
+
+// allocates memory aligned as the flags require, rounding the size up to the alignment
+static void *alignedAlloc(buffer_size_t *size, int flags) {
+	buffer_size_t align=(buffer_size_t) 1<<((flags&BUFFER_ALIGNMENT)>>8);
+	void *ptr;
+	
+	// huge pages are only worth it for data spanning at least one of them
+	int huge=(flags&BUFFER_HUGEPAGE)&&*size>=HUGE_PAGE_SIZE;
+	if(huge&&align<HUGE_PAGE_SIZE) align=HUGE_PAGE_SIZE;
+	if((size_t) align<sizeof(void*)) align=sizeof(void*);
+	
+	// aligned_alloc wants a multiple of the alignment
+	if(*size>BUFFER_SIZE_MAX-align) {
+		errno=ENOMEM;
+		return NULL;
+	}
+	buffer_size_t rounded=(*size+align-1)&~(align-1);
+	if(rounded==0) rounded=align;
+	ptr=aligned_alloc(align, rounded);
+	if(ptr==NULL) return NULL;
+	
+#if defined(BUFFER_HAS_MMAP)&&defined(MADV_HUGEPAGE)
+	if(huge) madvise(ptr, rounded, MADV_HUGEPAGE);
+#endif
+	
+	*size=rounded;
+	return ptr;
+}
+
+buffer_t *buffer_allocAlignedData(void* buffer, buffer_size_t size, buffer_size_t align, int flags, int destroy) {
 	buffer_t *buf=(buffer_t*) buffer;
+	int shift=0;
 	
 	if(buf==NULL) return NULL;
 	
-	buf->size=length*elem;
+	if(align&(align-1)||align>(buffer_size_t) 1<<30||flags&~BUFFER_HUGEPAGE) {
+		errno=EINVAL;
+		if(destroy) free(buf);
+		else buf->size=buf->alloc=0;
+		return NULL;
+	}
+	
+	// the alignment is stored in the flags as a power of two, so that resizing can keep it
+	while(((buffer_size_t) 1<<shift)<align) shift++;
+	
+	buf->size=size;
+	buf->alloc=size;
+	buf->user=0;
+	buf->flags=shift<<8|flags;
+	buf->ptr=alignedAlloc(&buf->alloc, buf->flags);
+	
+	if(buf->ptr==NULL) {
+		if(destroy) free(buf);
+		else buf->size=buf->alloc=0;
+		return NULL;
+	}
+	
+	return buf;
+}
+
+static int mulSize(buffer_size_t a, buffer_size_t b, buffer_size_t *res) {
+#if defined(__GNUC__)
+	return !__builtin_mul_overflow(a, b, res);
+#else
+	if(b!=0&&a>BUFFER_SIZE_MAX/b) return 0;
+	*res=a*b;
+	return 1;
+#endif
+}
+
+buffer_t *buffer_callocData(void* buffer, buffer_size_t length, buffer_size_t elem, int destroy) {
+	buffer_t *buf=(buffer_t*) buffer;
+	
+	if(buf==NULL) return NULL;
+	
+	if(!mulSize(length, elem, &buf->size)) {
+		if(destroy) free(buf);
+		else buf->size=buf->alloc=0;
+		return NULL;
+	}
 	buf->alloc=buf->size;
 	buf->user=0;
+	buf->flags=0;
 	buf->ptr=calloc(length, elem);
 	
 	if(buf->ptr==NULL) {
@@ -40,7 +165,7 @@ buffer_t *buffer_callocData(void* buffer, int length, int elem, int destroy) {
 	return buf;
 }
 
-buffer_t *buffer_wrapData(void* buffer, void* ptr, int size) {
+buffer_t *buffer_wrapData(void* buffer, void* ptr, buffer_size_t size) {
 	buffer_t *buf=(buffer_t*) buffer;
 	
 	if(buf==NULL) return NULL;
@@ -48,36 +173,1310 @@ buffer_t *buffer_wrapData(void* buffer, void* ptr, int size) {
 	buf->size=size;
 	buf->alloc=0;
 	buf->user=0;
+	buf->flags=0;
 	buf->ptr=ptr;
 	
 	return buf;
 }
 
+buffer_t *buffer_cloneData(void* buffer, const void* src, int destroy) {
+	buffer_t *buf=buffer_allocData(buffer, buffer_getSize(src), destroy);
+	
+	if(buf==NULL) return NULL;
+	
+	memcpy(buf->ptr, buffer_getPointer(src), buf->size);
+	buf->user=buffer_getUser(src);
+	
+	return buf;
+}
+
+buffer_t *buffer_viewData(void* buffer, void* parent, buffer_size_t start, buffer_size_t len, int destroy) {
+	buffer_t *buf=(buffer_t*) buffer;
+	
+	if(buf==NULL) return NULL;
+	
+	if(len<=0||start>buffer_getSize(parent)||len>buffer_getSize(parent)-start) {
+		if(destroy) free(buf);
+		return NULL;
+	}
+	if(!buffer_canPin(parent)) {
+		if(destroy) free(buf);
+		errno=EOVERFLOW;
+		return NULL;
+	}
+	// the contents of a ring move as it is pushed to and consumed from, which pinning can't prevent
+	if(buffer_getFlags(parent)&BUFFER_RING) {
+		if(destroy) free(buf);
+		errno=EINVAL;
+		return NULL;
+	}
+	
+	// the memory isn't ours, so leave alloc at zero so that it is never freed
+	buf->size=len;
+	buf->alloc=0;
+	buf->user=buffer_getUser(parent);
+	buf->flags=BUFFER_VIEW;
+	buf->ptr=buffer_getCharArray(parent)+start;
+	buffer_pin(parent);
+	
+	return buf;
+}
+
+#ifdef BUFFER_HAS_MMAP
+// mapped buffers are preceded by a page holding this header, so that the buffer struct itself doesn't grow
+typedef struct mapping_t {
+	int fd;
+	int mode;
+} mapping_t;
+
+static size_t pageSize(void) {
+	static size_t size=0;
+	if(size==0) size=sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+#define mappingOf(ptr) ((mapping_t*) ((char*) (ptr)-pageSize()))
+
+static void* mapRegion(int fd, int mode, buffer_size_t len) {
+	size_t page=pageSize();
+	
+	// reserve the header page and the file mapping together, so that a single munmap releases both
+	char* base=mmap(NULL, page+len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(base==MAP_FAILED) return NULL;
+	
+	int prot=mode==BUFFER_MAP_READ?PROT_READ:PROT_READ|PROT_WRITE;
+	int share=mode==BUFFER_MAP_WRITE?MAP_SHARED:MAP_PRIVATE;
+	if(mmap(base+page, len, prot, share|MAP_FIXED, fd, 0)==MAP_FAILED) {
+		int err=errno;
+		munmap(base, page+len);
+		errno=err;
+		return NULL;
+	}
+	
+	mapping_t *map=(mapping_t*) base;
+	map->fd=fd;
+	map->mode=mode;
+	return base+page;
+}
+
+static void unmapRegion(void* ptr, buffer_size_t len) {
+	munmap((char*) ptr-pageSize(), pageSize()+len);
+}
+
+static buffer_size_t remapData(buffer_t *buffer, buffer_size_t alloc) {
+	mapping_t *map=mappingOf(buffer->ptr);
+	int fd=map->fd;
+	
+	// only shared writable mappings can change the size of their file
+	if(map->mode!=BUFFER_MAP_WRITE) {
+		errno=EPERM;
+		return 0;
+	}
+	
+	// the data lives in the file, so mapping it again preserves it
+	if(alloc>buffer->alloc&&ftruncate(fd, alloc)) return 0;
+	void* ptr=mapRegion(fd, BUFFER_MAP_WRITE, alloc);
+	if(ptr==NULL) return 0;
+	unmapRegion(buffer->ptr, buffer->alloc);
+	if(alloc<buffer->alloc) ftruncate(fd, alloc);
+	
+	buffer->ptr=ptr;
+	buffer->alloc=alloc;
+	return alloc;
+}
+
+static void* mapFile(int fd, int mode, buffer_size_t *size) {
+	struct stat st;
+	if(fstat(fd, &st)) return NULL;
+	if((uintmax_t) st.st_size!=(uintmax_t) (buffer_size_t) st.st_size) {
+		errno=EFBIG;
+		return NULL;
+	}
+	if(*size==0) *size=st.st_size;
+	if(*size==0) {
+		errno=EINVAL;
+		return NULL;
+	}
+	
+	// only files opened for writing can be grown
+	if((uintmax_t) *size>(uintmax_t) st.st_size) {
+		if(mode!=BUFFER_MAP_WRITE) {
+			errno=EINVAL;
+			return NULL;
+		}
+		if(ftruncate(fd, *size)) return NULL;
+	}
+	
+	return mapRegion(fd, mode, *size);
+}
+#endif
+
+buffer_t *buffer_mapFileData(void* buffer, const char* path, int mode, buffer_size_t size, int destroy) {
+	buffer_t *buf=(buffer_t*) buffer;
+	
+	if(buf==NULL) return NULL;
+	
+#ifdef BUFFER_HAS_MMAP
+	int fd=open(path, mode==BUFFER_MAP_WRITE?O_RDWR|O_CREAT:O_RDONLY, 0666);
+	if(fd!=-1) {
+		void* ptr=mapFile(fd, mode, &size);
+		if(ptr!=NULL) {
+			// the file descriptor is only kept to resize the file
+			if(mode!=BUFFER_MAP_WRITE) {
+				mappingOf(ptr)->fd=-1;
+				close(fd);
+			}
+			
+			buf->size=size;
+			buf->alloc=size;
+			buf->user=0;
+			buf->flags=BUFFER_MAPPED;
+			buf->ptr=ptr;
+			return buf;
+		}
+		
+		int err=errno;
+		close(fd);
+		errno=err;
+	}
+#else
+	(void) path;
+	(void) mode;
+	(void) size;
+	errno=ENOSYS;
+#endif
+	
+	if(destroy) free(buf);
+	else {
+		buf->size=buf->alloc=0;
+		buf->flags=0;
+	}
+	return NULL;
+}
+
+int buffer_sync(void* buf) {
+#ifdef BUFFER_HAS_MMAP
+	buffer_t *buffer=(buffer_t*) buf;
+	if(buffer->flags&BUFFER_MAPPED&&mappingOf(buffer->ptr)->mode==BUFFER_MAP_WRITE) {
+		return !msync(buffer->ptr, buffer->size, MS_SYNC);
+	}
+#else
+	(void) buf;
+#endif
+	return 1;
+}
+
+#ifdef BUFFER_HAS_MMAP
+// largest single read or write, as some systems fail on larger ones
+#define IO_CHUNK ((buffer_size_t) 1<<30)
+
+static buffer_size_t transfer(int fd, char* ptr, buffer_size_t len, long long offset, int out) {
+	buffer_size_t done=0;
+	
+	while(done<len) {
+		size_t chunk=len-done<IO_CHUNK?len-done:IO_CHUNK;
+		ssize_t n;
+		if(out) n=offset<0?write(fd, ptr+done, chunk):pwrite(fd, ptr+done, chunk, offset+done);
+		else n=offset<0?read(fd, ptr+done, chunk):pread(fd, ptr+done, chunk, offset+done);
+		
+		if(n<0) {
+			if(errno==EINTR) continue;
+			return done?done:BUFFER_NPOS;
+		}
+		if(n==0) break;
+		done+=n;
+	}
+	return done;
+}
+
+static buffer_size_t readAll(buffer_t *buf, int fd) {
+	struct stat st;
+	buffer_size_t total=0;
+	
+	// regular files are read at once, other files in growing chunks until their end
+	int regular=!fstat(fd, &st)&&S_ISREG(st.st_mode)&&st.st_size>0;
+	if(regular&&(uintmax_t) st.st_size>(uintmax_t) BUFFER_SIZE_MAX) {
+		errno=EFBIG;
+		return BUFFER_NPOS;
+	}
+	if(!buffer_allocData(buf, regular?(buffer_size_t) st.st_size:65536, 0)) return BUFFER_NPOS;
+	
+	for(;;) {
+		buffer_size_t n=transfer(fd, (char*) buf->ptr+total, buf->size-total, -1, 0);
+		if(n==BUFFER_NPOS) break;
+		total+=n;
+		if(total<buf->size||regular) {
+			if(total==0) errno=EINVAL;
+			else {
+				buf->size=total;
+				return total;
+			}
+			break;
+		}
+		if(buf->size>BUFFER_SIZE_MAX/2) {
+			errno=EFBIG;
+			break;
+		}
+		if(!buffer_resize(buf, buf->size*2)) break;
+	}
+	
+	int err=errno;
+	buffer_destroyData(buf);
+	errno=err;
+	return BUFFER_NPOS;
+}
+#endif
+
+buffer_t *buffer_readFileData(void* buffer, const char* path, int destroy) {
+	buffer_t *buf=(buffer_t*) buffer;
+	
+	if(buf==NULL) return NULL;
+	
+#ifdef BUFFER_HAS_MMAP
+	int fd=open(path, O_RDONLY);
+	if(fd!=-1) {
+		buffer_size_t n=readAll(buf, fd);
+		int err=errno;
+		close(fd);
+		if(n!=BUFFER_NPOS) return buf;
+		errno=err;
+	}
+#else
+	(void) path;
+	errno=ENOSYS;
+#endif
+	
+	if(destroy) free(buf);
+	else {
+		buf->size=buf->alloc=0;
+		buf->flags=0;
+	}
+	return NULL;
+}
+
+buffer_size_t buffer_readFrom(void* buf, buffer_size_t idx, buffer_size_t len, int fd, long long offset) {
+	if(len>buffer_getSize(buf)||idx>buffer_getSize(buf)-len) {
+		errno=EINVAL;
+		return BUFFER_NPOS;
+	}
+#ifdef BUFFER_HAS_MMAP
+	return transfer(fd, buffer_getCharArray(buf)+idx, len, offset, 0);
+#else
+	(void) fd;
+	(void) offset;
+	errno=ENOSYS;
+	return BUFFER_NPOS;
+#endif
+}
+
+buffer_size_t buffer_writeTo(const void* buf, buffer_size_t idx, buffer_size_t len, int fd, long long offset) {
+	if(len>buffer_getSize(buf)||idx>buffer_getSize(buf)-len) {
+		errno=EINVAL;
+		return BUFFER_NPOS;
+	}
+#ifdef BUFFER_HAS_MMAP
+	return transfer(fd, buffer_getCharArray(buf)+idx, len, offset, 1);
+#else
+	(void) fd;
+	(void) offset;
+	errno=ENOSYS;
+	return BUFFER_NPOS;
+#endif
+}
+
+#ifdef BUFFER_HAS_MMAP
+// maps the same memory twice in a row, so that accessing past its end continues at its start
+static void* mirrorRegion(buffer_size_t len) {
+#ifdef MFD_CLOEXEC
+	int fd=memfd_create("buffer2-ring", MFD_CLOEXEC);
+	if(fd==-1) return NULL;
+	
+	// reserve both halves at once, so that they are adjacent
+	char* base=NULL;
+	if(!ftruncate(fd, len)) {
+		base=mmap(NULL, 2*len, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(base==MAP_FAILED) base=NULL;
+		else if(mmap(base, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0)==MAP_FAILED||mmap(base+len, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0)==MAP_FAILED) {
+			munmap(base, 2*len);
+			base=NULL;
+		}
+	}
+	
+	// the mappings keep the memory alive
+	close(fd);
+	return base;
+#else
+	(void) len;
+	return NULL;
+#endif
+}
+#endif
+
+static int ringAlloc(buffer_ring_t *ring, buffer_size_t capacity) {
+#ifdef BUFFER_HAS_MMAP
+	size_t page=pageSize();
+	if((size_t) capacity<=BUFFER_SIZE_MAX/2-page) {
+		buffer_size_t len=(capacity+page-1)/page*page;
+		void* base=mirrorRegion(len);
+		if(base!=NULL) {
+			ring->base=base;
+			ring->buf.alloc=len;
+			ring->buf.flags=BUFFER_RING|BUFFER_MIRRORED;
+			return 1;
+		}
+	}
+#endif
+	
+	// fall back to plain memory, whose contents are moved back to its start when they reach its end
+	void* base=malloc(capacity);
+	if(base==NULL) return 0;
+	ring->base=base;
+	ring->buf.alloc=capacity;
+	ring->buf.flags=BUFFER_RING;
+	return 1;
+}
+
+static void ringFree(buffer_ring_t *ring) {
+#ifdef BUFFER_HAS_MMAP
+	if(ring->buf.flags&BUFFER_MIRRORED) {
+		munmap(ring->base, 2*ring->buf.alloc);
+		return;
+	}
+#endif
+	free(ring->base);
+}
+
+// pools carve slots from large blocks, each slot holding the data of one buffer, or an inline buffer
+#define POOL_BLOCK 65536
+#define POOL_MIN 16
+#define POOL_CLASSES 9
+
+// slot states
+#define SLOT_FREE 0
+#define SLOT_DATA 1
+#define SLOT_BUFFER 2
+
+typedef struct poolslot_t {
+	buffer_pool_t *pool;
+	struct poolslot_t *next;
+	int sizeClass;
+	int state;
+	_Alignas(16) char data[];
+} poolslot_t;
+
+typedef struct poolblock_t {
+	struct poolblock_t *next;
+	size_t used;
+	_Alignas(16) char data[POOL_BLOCK];
+} poolblock_t;
+
+struct buffer_pool_t {
+	poolslot_t *freelists[POOL_CLASSES];
+	poolblock_t *blocks;
+	poolblock_t *current;
+};
+
+#define slotOf(ptr) ((poolslot_t*) ((char*) (ptr)-offsetof(poolslot_t, data)))
+#define classSize(sizeClass) ((size_t) POOL_MIN<<(sizeClass))
+#define slotSize(sizeClass) (sizeof(poolslot_t)+classSize(sizeClass))
+
+static poolslot_t *allocSlot(buffer_pool_t *pool, size_t size, int state) {
+	int sizeClass=0;
+	while(classSize(sizeClass)<size) sizeClass++;
+	
+	// reuse a freed slot of the same class if possible, otherwise carve one from the blocks
+	poolslot_t *slot=pool->freelists[sizeClass];
+	if(slot!=NULL) pool->freelists[sizeClass]=slot->next;
+	else {
+		while(pool->current->used+slotSize(sizeClass)>POOL_BLOCK) {
+			if(pool->current->next==NULL) {
+				poolblock_t *block=malloc(sizeof(poolblock_t));
+				if(block==NULL) return NULL;
+				block->next=NULL;
+				block->used=0;
+				pool->current->next=block;
+			}
+			pool->current=pool->current->next;
+		}
+		slot=(poolslot_t*) (pool->current->data+pool->current->used);
+		pool->current->used+=slotSize(sizeClass);
+		slot->pool=pool;
+		slot->sizeClass=sizeClass;
+	}
+	
+	slot->state=state;
+	return slot;
+}
+
+static void freeSlot(poolslot_t *slot) {
+	buffer_pool_t *pool=slot->pool;
+	slot->state=SLOT_FREE;
+	slot->next=pool->freelists[slot->sizeClass];
+	pool->freelists[slot->sizeClass]=slot;
+}
+
 void buffer_destroyData(void* buf) {
 	if(buf==NULL) return;
+	if(buffer_getFlags(buf)&BUFFER_POOLED) {
+		freeSlot(slotOf(buffer_getPointer(buf)));
+		return;
+	}
+	if(buffer_getFlags(buf)&BUFFER_INLINE) return;
+	if(buffer_getFlags(buf)&BUFFER_RING) {
+		ringFree((buffer_ring_t*) buf);
+		return;
+	}
+#ifdef BUFFER_HAS_MMAP
+	if(buffer_getFlags(buf)&BUFFER_MAPPED) {
+		buffer_t *buffer=(buffer_t*) buf;
+		int fd=mappingOf(buffer->ptr)->fd;
+		unmapRegion(buffer->ptr, buffer->alloc);
+		if(fd!=-1) {
+			// drop the space reserved by the growth policy
+			if(buffer->size<buffer->alloc) ftruncate(fd, buffer->size);
+			close(fd);
+		}
+		return;
+	}
+#endif
 	if(buffer_getAllocatedSize(buf)) free(buffer_getPointer(buf));
 }
 
-int buffer_resize(void* buf, int size) {
+static double growthFactor=BUFFER_DEFAULT_GROWTH;
+
+void buffer_setGrowthFactor(double factor) {
+	growthFactor=factor;
+}
+
+double buffer_getGrowthFactor(void) {
+	return growthFactor;
+}
+
+// grows an allocated size geometrically, so that successive enlargements don't copy everything each time
+static buffer_size_t grownSize(buffer_size_t alloc, buffer_size_t size) {
+	double grown=alloc*growthFactor;
+	if(grown>=(double) BUFFER_SIZE_MAX) return BUFFER_SIZE_MAX;
+	if(grown>size) return (buffer_size_t) grown;
+	return size;
+}
+
+static buffer_size_t reallocData(buffer_t *buffer, buffer_size_t alloc) {
+	void* ptr;
+	
+	// views and pinned buffers have pointers into their memory, which must not move, and rings manage their own
+	if(buffer->flags&(BUFFER_VIEW|BUFFER_RING)||buffer_isPinned(buffer)) {
+		errno=EBUSY;
+		return 0;
+	}
+	
+#ifdef BUFFER_HAS_MMAP
+	if(buffer->flags&BUFFER_MAPPED) return remapData(buffer, alloc);
+#endif
+	
+	if(buffer->flags&(BUFFER_ALIGNMENT|BUFFER_HUGEPAGE)) {
+		// realloc would lose the alignment, so the data moves to a new aligned allocation
+		ptr=alignedAlloc(&alloc, buffer->flags);
+		if(ptr==NULL) return 0;
+		memcpy(ptr, buffer->ptr, buffer->size<alloc?buffer->size:alloc);
+		free(buffer->ptr);
+	} else if(buffer->alloc&&!(buffer->flags&(BUFFER_INLINE|BUFFER_POOLED))) {
+		ptr=realloc(buffer->ptr, alloc);
+		if(ptr==NULL) return 0;
+	} else {
+		// wrapped, inline and pooled memory isn't ours to realloc, so move the data out of it
+		ptr=malloc(alloc);
+		if(ptr==NULL) return 0;
+		if(buffer->ptr!=NULL) memcpy(ptr, buffer->ptr, buffer->size<alloc?buffer->size:alloc);
+		if(buffer->flags&BUFFER_POOLED) freeSlot(slotOf(buffer->ptr));
+		buffer->flags&=~(BUFFER_INLINE|BUFFER_POOLED);
+	}
+	
+	buffer->ptr=ptr;
+	buffer->alloc=alloc;
+	return alloc;
+}
+
+buffer_size_t buffer_resize(void* buf, buffer_size_t size) {
+	buffer_t *buffer=(buffer_t*) buf;
+	
+	if(size<=0||buffer->flags&(BUFFER_VIEW|BUFFER_RING)) return 0;
+	
+	if(buffer->alloc<size) {
+		// a large growth factor may ask for more memory than there is, while the exact size would still fit
+		buffer_size_t alloc=grownSize(buffer->alloc, size);
+		if(!reallocData(buffer, alloc)&&(alloc==size||!reallocData(buffer, size))) return 0;
+	}
+	
+	buffer->size=size;
+	return buffer->alloc;
+}
+
+buffer_size_t buffer_reserve(void* buf, buffer_size_t size) {
 	buffer_t *buffer=(buffer_t*) buf;
 	
 	if(size<=0) return 0;
+	if(buffer->alloc>=size) return buffer->alloc;
+	return reallocData(buffer, size);
+}
+
+buffer_size_t buffer_shrinkToFit(void* buf) {
+	buffer_t *buffer=(buffer_t*) buf;
 	
-	if(buffer->alloc>=size) {
-		buffer->size=size;
-		return buffer->alloc;
-	} else if(buffer->alloc) {
-		void* ptr=realloc(buffer->ptr, size);
-		if(ptr==NULL) return 0;
-		buffer->ptr=ptr;
-		buffer->size=size;
-		buffer->alloc=size;
-		return size;
+	// views and wrapped buffers don't own their memory, so there is nothing to release
+	if(buffer->alloc==0) return buffer->size;
+	
+	// inline and pooled data would have to move to a new allocation, which wouldn't release anything
+	if(buffer->alloc<=buffer->size||buffer->size<=0||buffer->flags&(BUFFER_INLINE|BUFFER_POOLED)) return buffer->alloc;
+	return reallocData(buffer, buffer->size);
+}
+
+// copy between ranges that don't overlap, split between threads
+typedef struct {
+	char* to;
+	const char* from;
+} copyjob_t;
+
+static void copyTask(void* ctx, buffer_size_t first, buffer_size_t last, int chunk) {
+	copyjob_t *job=(copyjob_t*) ctx;
+	(void) chunk;
+	memcpy(job->to+first, job->from+first, last-first);
+}
+
+int buffer_copy(void* dst, buffer_size_t didx, const void* src, buffer_size_t sidx, buffer_size_t len) {
+	if(len>buffer_getSize(src)||sidx>buffer_getSize(src)-len) return 0;
+	if(len>buffer_getSize(dst)||didx>buffer_getSize(dst)-len) return 0;
+	
+	char* to=buffer_getCharArray(dst)+didx;
+	const char* from=buffer_getCharArray(src)+sidx;
+	
+	// memcpy is only allowed when the ranges don't overlap, which can also happen between wrapped buffers
+	if((uintptr_t) to+len<=(uintptr_t) from||(uintptr_t) from+len<=(uintptr_t) to) {
+		if(len<2*BUFFER_PARALLEL_GRAIN) memcpy(to, from, len);
+		else {
+			copyjob_t job={to, from};
+			buffer_parallel(len, BUFFER_PARALLEL_GRAIN, copyTask, &job);
+		}
+	} else memmove(to, from, len);
+	return 1;
+}
+
+// search implementations
+// each one takes the data, its size, the start offset, and the needle, and returns an offset or BUFFER_NPOS
+typedef buffer_size_t (*findFn)(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* sub, buffer_size_t len);
+
+static buffer_size_t findScalar(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* sub, buffer_size_t len) {
+	const unsigned char* end=data+size-len+1;
+	const unsigned char* ptr=data+start;
+	
+	while(ptr<end&&(ptr=memchr(ptr, sub[0], end-ptr))!=NULL) {
+		if(!memcmp(ptr+1, sub+1, len-1)) return ptr-data;
+		ptr++;
+	}
+	return BUFFER_NPOS;
+}
+
+static buffer_size_t findValueScalar(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* value, buffer_size_t elem) {
+	for(buffer_size_t off=start*elem; off+elem<=size; off+=elem) {
+		if(!memcmp(data+off, value, elem)) return off/elem;
+	}
+	return BUFFER_NPOS;
+}
+
+#ifdef BUFFER_X86_SIMD
+// keeps the bits of a byte mask for which all elem bytes of an element matched, at the position of its first byte
+static inline uint32_t collapseMask(uint32_t mask, buffer_size_t elem) {
+	uint32_t all=mask;
+	for(buffer_size_t b=1; b<elem; b++) all&=mask>>b;
+	switch(elem) {
+		case 2: return all&0x55555555;
+		case 4: return all&0x11111111;
+		case 8: return all&0x01010101;
+	}
+	return all;
+}
+
+// first/last byte filter: compares the first and last bytes of the needle with a whole block at once
+// and only compares the rest of the needle where both match
+static buffer_size_t findSSE2(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* sub, buffer_size_t len) {
+	__m128i first=_mm_set1_epi8(sub[0]);
+	__m128i last=_mm_set1_epi8(sub[len-1]);
+	buffer_size_t i=start;
+	
+	for(; i+len-1+16<=size; i+=16) {
+		__m128i a=_mm_loadu_si128((const __m128i*) (data+i));
+		__m128i b=_mm_loadu_si128((const __m128i*) (data+i+len-1));
+		uint32_t mask=_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while(mask) {
+			int bit=__builtin_ctz(mask);
+			if(!memcmp(data+i+bit+1, sub+1, len-2)) return i+bit;
+			mask&=mask-1;
+		}
+	}
+	return findScalar(data, size, i, sub, len);
+}
+
+__attribute__((target("avx2")))
+static buffer_size_t findAVX2(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* sub, buffer_size_t len) {
+	__m256i first=_mm256_set1_epi8(sub[0]);
+	__m256i last=_mm256_set1_epi8(sub[len-1]);
+	buffer_size_t i=start;
+	
+	for(; i+len-1+32<=size; i+=32) {
+		__m256i a=_mm256_loadu_si256((const __m256i*) (data+i));
+		__m256i b=_mm256_loadu_si256((const __m256i*) (data+i+len-1));
+		uint32_t mask=_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while(mask) {
+			int bit=__builtin_ctz(mask);
+			if(!memcmp(data+i+bit+1, sub+1, len-2)) return i+bit;
+			mask&=mask-1;
+		}
+	}
+	return findScalar(data, size, i, sub, len);
+}
+
+// typed search: compares whole blocks against the value repeated across a vector
+static buffer_size_t findValueSSE2(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* value, buffer_size_t elem) {
+	unsigned char pattern[16];
+	for(int i=0; i<16; i++) pattern[i]=value[i%elem];
+	__m128i pat=_mm_loadu_si128((const __m128i*) pattern);
+	buffer_size_t off=start*elem;
+	
+	for(; off+16<=size; off+=16) {
+		__m128i a=_mm_loadu_si128((const __m128i*) (data+off));
+		uint32_t mask=collapseMask(_mm_movemask_epi8(_mm_cmpeq_epi8(a, pat)), elem);
+		if(mask) return (off+__builtin_ctz(mask))/elem;
+	}
+	return findValueScalar(data, size, off/elem, value, elem);
+}
+
+__attribute__((target("avx2")))
+static buffer_size_t findValueAVX2(const unsigned char* data, buffer_size_t size, buffer_size_t start, const unsigned char* value, buffer_size_t elem) {
+	unsigned char pattern[32];
+	for(int i=0; i<32; i++) pattern[i]=value[i%elem];
+	__m256i pat=_mm256_loadu_si256((const __m256i*) pattern);
+	buffer_size_t off=start*elem;
+	
+	for(; off+32<=size; off+=32) {
+		__m256i a=_mm256_loadu_si256((const __m256i*) (data+off));
+		uint32_t mask=collapseMask(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, pat)), elem);
+		if(mask) return (off+__builtin_ctz(mask))/elem;
+	}
+	return findValueScalar(data, size, off/elem, value, elem);
+}
+#endif
+
+// runtime dispatch, resolved when the library is loaded so that threads never race on it
+#ifdef BUFFER_X86_SIMD
+static findFn findImpl=findSSE2;
+static findFn findValueImpl=findValueSSE2;
+
+__attribute__((constructor))
+static void resolveFind(void) {
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		findImpl=findAVX2;
+		findValueImpl=findValueAVX2;
+	}
+}
+#else
+static findFn findImpl=findScalar;
+static findFn findValueImpl=findValueScalar;
+#endif
+
+buffer_size_t buffer_find(const void* buf, buffer_size_t start, const void* sub, buffer_size_t len) {
+	buffer_size_t size=buffer_getSize(buf);
+	const unsigned char* data=buffer_getPointer(buf);
+	
+	if(start>size||len>size-start) return BUFFER_NPOS;
+	if(len==0) return start;
+	if(len==1) {
+		const unsigned char* ptr=memchr(data+start, *(const unsigned char*) sub, size-start);
+		return ptr==NULL?BUFFER_NPOS:(buffer_size_t) (ptr-data);
+	}
+	
+	return findImpl(data, size, start, sub, len);
+}
+
+buffer_size_t buffer_findValue(const void* buf, buffer_size_t start, const void* value, buffer_size_t elem) {
+	buffer_size_t size=buffer_getSize(buf);
+	const unsigned char* data=buffer_getPointer(buf);
+	
+	if(elem==0||start>=size/elem) return BUFFER_NPOS;
+	if(elem!=1&&elem!=2&&elem!=4&&elem!=8) return findValueScalar(data, size, start, value, elem);
+	
+	return findValueImpl(data, size, start, value, elem);
+}
+
+// byte swapping of single values
+#if defined(__GNUC__)
+#define bswap16(x) __builtin_bswap16(x)
+#define bswap32(x) __builtin_bswap32(x)
+#define bswap64(x) __builtin_bswap64(x)
+#else
+#define bswap16(x) ((uint16_t) ((x)<<8|(x)>>8))
+#define bswap32(x) ((uint32_t) bswap16((uint16_t) (x))<<16|bswap16((uint16_t) ((x)>>16)))
+#define bswap64(x) ((uint64_t) bswap32((uint32_t) (x))<<32|bswap32((uint32_t) ((x)>>32)))
+#endif
+
+// byte swap implementations
+// each one swaps the bytes of the n elements of elem bytes at data, elem being 2, 4 or 8
+typedef void (*byteswapFn)(unsigned char* data, buffer_size_t n, buffer_size_t elem);
+
+static void byteswapScalar(unsigned char* data, buffer_size_t n, buffer_size_t elem) {
+	// elements may be unaligned, so they are accessed through memcpy
+	switch(elem) {
+		case 2:
+			for(buffer_size_t k=0; k<n; k++) {
+				uint16_t v;
+				memcpy(&v, data+k*2, 2);
+				v=bswap16(v);
+				memcpy(data+k*2, &v, 2);
+			}
+			break;
+		case 4:
+			for(buffer_size_t k=0; k<n; k++) {
+				uint32_t v;
+				memcpy(&v, data+k*4, 4);
+				v=bswap32(v);
+				memcpy(data+k*4, &v, 4);
+			}
+			break;
+		case 8:
+			for(buffer_size_t k=0; k<n; k++) {
+				uint64_t v;
+				memcpy(&v, data+k*8, 8);
+				v=bswap64(v);
+				memcpy(data+k*8, &v, 8);
+			}
+			break;
+	}
+}
+
+#ifdef BUFFER_X86_SIMD
+// shuffle reversing every element of a 16 bytes lane
+static const unsigned char byteswapMasks[3][16]={
+	{1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+	{3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+	{7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8}
+};
+#define byteswapMask(elem) byteswapMasks[(elem)==2?0:(elem)==4?1:2]
+
+__attribute__((target("ssse3")))
+static void byteswapSSSE3(unsigned char* data, buffer_size_t n, buffer_size_t elem) {
+	__m128i mask=_mm_loadu_si128((const __m128i*) byteswapMask(elem));
+	buffer_size_t size=n*elem, off=0;
+	
+	for(; off+16<=size; off+=16) {
+		__m128i a=_mm_loadu_si128((const __m128i*) (data+off));
+		_mm_storeu_si128((__m128i*) (data+off), _mm_shuffle_epi8(a, mask));
+	}
+	byteswapScalar(data+off, n-off/elem, elem);
+}
+
+__attribute__((target("avx2")))
+static void byteswapAVX2(unsigned char* data, buffer_size_t n, buffer_size_t elem) {
+	__m256i mask=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) byteswapMask(elem)));
+	buffer_size_t size=n*elem, off=0;
+	
+	for(; off+32<=size; off+=32) {
+		__m256i a=_mm256_loadu_si256((const __m256i*) (data+off));
+		_mm256_storeu_si256((__m256i*) (data+off), _mm256_shuffle_epi8(a, mask));
+	}
+	byteswapScalar(data+off, n-off/elem, elem);
+}
+#undef byteswapMask
+#endif
+
+// runtime dispatch, resolved when the library is loaded so that threads never race on it
+static byteswapFn byteswapImpl=byteswapScalar;
+
+#ifdef BUFFER_X86_SIMD
+__attribute__((constructor))
+static void resolveByteswap(void) {
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) byteswapImpl=byteswapAVX2;
+	else if(__builtin_cpu_supports("ssse3")) byteswapImpl=byteswapSSSE3;
+}
+#endif
+
+int buffer_byteswap(void* buf, buffer_size_t start, buffer_size_t len, buffer_size_t elem) {
+	buffer_size_t size=buffer_getSize(buf);
+	
+	if(elem==0||start>size/elem||len>size/elem-start) return 0;
+	if(elem==1) return 1;
+	if(elem!=2&&elem!=4&&elem!=8) return 0;
+	
+	byteswapImpl((unsigned char*) buffer_getPointer(buf)+start*elem, len, elem);
+	return 1;
+}
+
+buffer_ring_t *buffer_ringCreateData(void* buffer, buffer_size_t capacity, int destroy) {
+	buffer_ring_t *ring=(buffer_ring_t*) buffer;
+	
+	if(ring==NULL) return NULL;
+	
+	if(capacity<=0||!ringAlloc(ring, capacity)) {
+		if(destroy) free(ring);
+		else {
+			ring->buf.size=ring->buf.alloc=0;
+			ring->buf.flags=0;
+		}
+		return NULL;
+	}
+	
+	ring->buf.size=0;
+	ring->buf.user=0;
+	ring->buf.ptr=ring->base;
+	return ring;
+}
+
+void* buffer_ringReserve(buffer_ring_t* ring, buffer_size_t len) {
+	buffer_t *buf=&ring->buf;
+	
+	if(len>BUFFER_SIZE_MAX-buf->size) return NULL;
+	
+	if(buf->size+len>buf->alloc) {
+		// growing moves the memory, which a pinned ring keeps in place, like other buffers
+		if(buffer_isPinned(buf)) {
+			errno=EBUSY;
+			return NULL;
+		}
+		
+		// the contents are contiguous in both rings, so a single copy moves them
+		buffer_ring_t old=*ring;
+		if(!ringAlloc(ring, grownSize(buf->alloc, buf->size+len))) {
+			*ring=old;
+			return NULL;
+		}
+		memcpy(ring->base, old.buf.ptr, old.buf.size);
+		buf->ptr=ring->base;
+		ringFree(&old);
+	} else if(!(buf->flags&BUFFER_MIRRORED)&&(buffer_size_t) ((char*) buf->ptr-(char*) ring->base)+buf->size+len>buf->alloc) {
+		memmove(ring->base, buf->ptr, buf->size);
+		buf->ptr=ring->base;
+	}
+	
+	return (char*) buf->ptr+buf->size;
+}
+
+int buffer_ringPush(buffer_ring_t* ring, const void* data, buffer_size_t len) {
+	void* ptr=buffer_ringReserve(ring, len);
+	
+	if(ptr==NULL) return 0;
+	
+	memcpy(ptr, data, len);
+	buffer_ringCommit(ring, len);
+	return 1;
+}
+
+buffer_size_t buffer_ringPeek(const buffer_ring_t* ring, void* dst, buffer_size_t len) {
+	if(len>ring->buf.size) len=ring->buf.size;
+	memcpy(dst, ring->buf.ptr, len);
+	return len;
+}
+
+buffer_size_t buffer_ringConsume(buffer_ring_t* ring, buffer_size_t len) {
+	buffer_t *buf=&ring->buf;
+	
+	if(len>buf->size) len=buf->size;
+	buf->size-=len;
+	
+	if(buf->size==0) {
+		// restarting from the start of an empty ring saves moving its contents later
+		buf->ptr=ring->base;
 	} else {
-		buffer->ptr=malloc(size);
-		if(buffer->ptr==NULL) return 0;
-		buffer->size=size;
-		buffer->alloc=size;
-		return size;
+		buf->ptr=(char*) buf->ptr+len;
+		
+		// the second mapping mirrors the first one, so stay in the first one
+		if(buf->flags&BUFFER_MIRRORED&&(char*) buf->ptr>=(char*) ring->base+buf->alloc) buf->ptr=(char*) buf->ptr-buf->alloc;
+	}
+	return len;
+}
+
+buffer_size_t buffer_ringPop(buffer_ring_t* ring, void* dst, buffer_size_t len) {
+	return buffer_ringConsume(ring, buffer_ringPeek(ring, dst, len));
+}
+
+// cache line size, which keeps the indices of each side of a queue apart
+#define CACHE_LINE 64
+
+// indices grow forever and are masked when accessing memory, so that a full queue and an empty one differ
+struct buffer_spsc_t {
+	// written by the producer
+	_Alignas(CACHE_LINE) atomic_size_t tail;
+	size_t headCache;
+	
+	// written by the consumer
+	_Alignas(CACHE_LINE) atomic_size_t head;
+	size_t tailCache;
+	
+	// written once
+	_Alignas(CACHE_LINE) char* base;
+	size_t capacity;
+	int mirrored;
+};
+
+buffer_spsc_t *buffer_spscCreate(buffer_size_t capacity) {
+	size_t len=CACHE_LINE;
+#ifdef BUFFER_HAS_MMAP
+	if(len<pageSize()) len=pageSize();
+#endif
+	while(len<(size_t) capacity) {
+		if(len>(size_t) BUFFER_SIZE_MAX/4) return NULL;
+		len*=2;
+	}
+	
+	buffer_spsc_t *queue=aligned_alloc(CACHE_LINE, sizeof(buffer_spsc_t));
+	if(queue==NULL) return NULL;
+	
+	queue->base=NULL;
+#ifdef BUFFER_HAS_MMAP
+	queue->base=mirrorRegion(len);
+#endif
+	queue->mirrored=queue->base!=NULL;
+	if(!queue->mirrored) queue->base=malloc(len);
+	if(queue->base==NULL) {
+		free(queue);
+		return NULL;
+	}
+	
+	queue->capacity=len;
+	atomic_init(&queue->tail, 0);
+	atomic_init(&queue->head, 0);
+	queue->headCache=0;
+	queue->tailCache=0;
+	return queue;
+}
+
+void buffer_spscDestroy(buffer_spsc_t* queue) {
+	if(queue==NULL) return;
+#ifdef BUFFER_HAS_MMAP
+	if(queue->mirrored) munmap(queue->base, 2*queue->capacity);
+	else
+#endif
+	free(queue->base);
+	free(queue);
+}
+
+buffer_size_t buffer_spscGetCapacity(const buffer_spsc_t* queue) {
+	return queue->capacity;
+}
+
+buffer_size_t buffer_spscGetLength(buffer_spsc_t* queue) {
+	size_t head=atomic_load_explicit(&queue->head, memory_order_acquire);
+	return atomic_load_explicit(&queue->tail, memory_order_acquire)-head;
+}
+
+void* buffer_spscReserve(buffer_spsc_t* queue, buffer_size_t* len) {
+	size_t tail=atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	
+	// only look at the consumer's index when the last one seen doesn't leave enough room
+	if(queue->capacity-(tail-queue->headCache)<(size_t) *len) queue->headCache=atomic_load_explicit(&queue->head, memory_order_acquire);
+	
+	size_t room=queue->capacity-(tail-queue->headCache);
+	size_t off=tail&(queue->capacity-1);
+	if(!queue->mirrored&&room>queue->capacity-off) room=queue->capacity-off;
+	*len=room;
+	return queue->base+off;
+}
+
+void buffer_spscCommit(buffer_spsc_t* queue, buffer_size_t len) {
+	size_t tail=atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	atomic_store_explicit(&queue->tail, tail+len, memory_order_release);
+}
+
+buffer_size_t buffer_spscPush(buffer_spsc_t* queue, const void* data, buffer_size_t len) {
+	size_t tail=atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	if(queue->capacity-(tail-queue->headCache)<(size_t) len) queue->headCache=atomic_load_explicit(&queue->head, memory_order_acquire);
+	
+	size_t room=queue->capacity-(tail-queue->headCache);
+	if((size_t) len>room) len=room;
+	
+	// without the second mapping, the bytes past the end of the memory go to its start
+	size_t off=tail&(queue->capacity-1);
+	size_t first=len;
+	if(!queue->mirrored&&first>queue->capacity-off) first=queue->capacity-off;
+	memcpy(queue->base+off, data, first);
+	memcpy(queue->base, (const char*) data+first, len-first);
+	
+	atomic_store_explicit(&queue->tail, tail+len, memory_order_release);
+	return len;
+}
+
+const void* buffer_spscPeek(buffer_spsc_t* queue, buffer_size_t* len) {
+	size_t head=atomic_load_explicit(&queue->head, memory_order_relaxed);
+	
+	// only look at the producer's index when the last one seen doesn't hold enough bytes
+	if(queue->tailCache-head<(size_t) *len) queue->tailCache=atomic_load_explicit(&queue->tail, memory_order_acquire);
+	
+	size_t avail=queue->tailCache-head;
+	size_t off=head&(queue->capacity-1);
+	if(!queue->mirrored&&avail>queue->capacity-off) avail=queue->capacity-off;
+	*len=avail;
+	return queue->base+off;
+}
+
+void buffer_spscConsume(buffer_spsc_t* queue, buffer_size_t len) {
+	size_t head=atomic_load_explicit(&queue->head, memory_order_relaxed);
+	atomic_store_explicit(&queue->head, head+len, memory_order_release);
+}
+
+buffer_size_t buffer_spscPop(buffer_spsc_t* queue, void* dst, buffer_size_t len) {
+	size_t head=atomic_load_explicit(&queue->head, memory_order_relaxed);
+	if(queue->tailCache-head<(size_t) len) queue->tailCache=atomic_load_explicit(&queue->tail, memory_order_acquire);
+	
+	size_t avail=queue->tailCache-head;
+	if((size_t) len>avail) len=avail;
+	
+	size_t off=head&(queue->capacity-1);
+	size_t first=len;
+	if(!queue->mirrored&&first>queue->capacity-off) first=queue->capacity-off;
+	memcpy(dst, queue->base+off, first);
+	memcpy((char*) dst+first, queue->base, len-first);
+	
+	atomic_store_explicit(&queue->head, head+len, memory_order_release);
+	return len;
+}
+
+buffer_pool_t *buffer_poolCreate(void) {
+	buffer_pool_t *pool=malloc(sizeof(buffer_pool_t));
+	if(pool==NULL) return NULL;
+	
+	pool->blocks=malloc(sizeof(poolblock_t));
+	if(pool->blocks==NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->blocks->next=NULL;
+	pool->blocks->used=0;
+	pool->current=pool->blocks;
+	for(int i=0; i<POOL_CLASSES; i++) pool->freelists[i]=NULL;
+	
+	return pool;
+}
+
+void buffer_poolDestroy(buffer_pool_t* pool) {
+	if(pool==NULL) return;
+	
+	buffer_poolReset(pool);
+	while(pool->blocks!=NULL) {
+		poolblock_t *next=pool->blocks->next;
+		free(pool->blocks);
+		pool->blocks=next;
+	}
+	free(pool);
+}
+
+buffer_t *buffer_poolAlloc(buffer_pool_t* pool, buffer_size_t size) {
+	poolslot_t *slot;
+	buffer_t *buf;
+	
+	if(size<=0) return NULL;
+	
+	if((size_t) size<=BUFFER_POOL_MAX-sizeof(buffer_t)) {
+		slot=allocSlot(pool, sizeof(buffer_t)+size, SLOT_BUFFER);
+		if(slot==NULL) return NULL;
+		
+		buf=buffer_inlineData(slot->data, size);
+		buf->alloc=classSize(slot->sizeClass)-sizeof(buffer_t);
+		return buf;
+	}
+	
+	// only the struct fits in the pool
+	slot=allocSlot(pool, sizeof(buffer_t), SLOT_BUFFER);
+	if(slot==NULL) return NULL;
+	buf=buffer_allocData(slot->data, size, 0);
+	if(buf==NULL) freeSlot(slot);
+	return buf;
+}
+
+buffer_t *buffer_poolAllocData(void* buffer, buffer_pool_t* pool, buffer_size_t size, int destroy) {
+	buffer_t *buf=(buffer_t*) buffer;
+	
+	if(buf==NULL) return NULL;
+	if(size>BUFFER_POOL_MAX) return buffer_allocData(buf, size, destroy);
+	
+	poolslot_t *slot=size>0?allocSlot(pool, size, SLOT_DATA):NULL;
+	if(slot==NULL) {
+		if(destroy) free(buf);
+		else {
+			buf->size=buf->alloc=0;
+			buf->flags=0;
+		}
+		return NULL;
+	}
+	
+	buf->size=size;
+	buf->alloc=classSize(slot->sizeClass);
+	buf->user=0;
+	buf->flags=BUFFER_POOLED;
+	buf->ptr=slot->data;
+	return buf;
+}
+
+void buffer_poolFree(void* buf) {
+	if(buf==NULL) return;
+	
+	buffer_destroyData(buf);
+	freeSlot(slotOf(buf));
+}
+
+void buffer_poolReset(buffer_pool_t* pool) {
+	for(poolblock_t *block=pool->blocks; block!=NULL; block=block->next) {
+		// the data of inline buffers may have moved to its own allocation
+		for(size_t off=0; off<block->used; ) {
+			poolslot_t *slot=(poolslot_t*) (block->data+off);
+			if(slot->state==SLOT_BUFFER) buffer_destroyData(slot->data);
+			off+=slotSize(slot->sizeClass);
+		}
+		block->used=0;
+	}
+	
+	pool->current=pool->blocks;
+	for(int i=0; i<POOL_CLASSES; i++) pool->freelists[i]=NULL;
+}
+
+// number of threads running an operation, counting the calling one
+static atomic_int threadCount=1;
+
+int buffer_getThreads(void) {
+	return atomic_load(&threadCount);
+}
+
+#ifdef BUFFER_HAS_THREADS
+// operation being run by the pool, whose chunks are grabbed in order by every thread taking part
+typedef struct {
+	buffer_task_t task;
+	void* ctx;
+	buffer_size_t len;
+	int chunks;
+	atomic_int next;
+	atomic_int remaining;
+} job_t;
+
+// the pool of worker threads
+// busy is held by the operation using the pool, as well as while starting and stopping workers
+// lock protects the rest, except the chunk counters of the job
+// a job is published by bumping the generation, and the next one can only be published once no worker is running the previous one
+static struct {
+	pthread_mutex_t busy, lock;
+	pthread_cond_t wake, done;
+	pthread_t workers[BUFFER_MAX_THREADS-1];
+	int count;
+	int stop;
+	int active;
+	unsigned long generation;
+	job_t job;
+} threadPool={
+	.busy=PTHREAD_MUTEX_INITIALIZER,
+	.lock=PTHREAD_MUTEX_INITIALIZER,
+	.wake=PTHREAD_COND_INITIALIZER,
+	.done=PTHREAD_COND_INITIALIZER
+};
+
+// runs chunks of a job until there are none left, and wakes the publisher after the last one
+static void runChunks(job_t* job) {
+	buffer_size_t step=job->len/job->chunks, extra=job->len%job->chunks;
+	int chunk;
+	
+	while((chunk=atomic_fetch_add(&job->next, 1))<job->chunks) {
+		// the first chunks take one more element each when the length doesn't divide evenly
+		buffer_size_t first=chunk*step+((buffer_size_t) chunk<extra?(buffer_size_t) chunk:extra);
+		buffer_size_t last=first+step+((buffer_size_t) chunk<extra);
+		job->task(job->ctx, first, last, chunk);
+		
+		if(atomic_fetch_sub(&job->remaining, 1)==1) {
+			pthread_mutex_lock(&threadPool.lock);
+			pthread_cond_broadcast(&threadPool.done);
+			pthread_mutex_unlock(&threadPool.lock);
+		}
+	}
+}
+
+static void *workerMain(void* arg) {
+	(void) arg;
+	pthread_mutex_lock(&threadPool.lock);
+	unsigned long seen=threadPool.generation;
+	
+	for(;;) {
+		while(!threadPool.stop&&threadPool.generation==seen) pthread_cond_wait(&threadPool.wake, &threadPool.lock);
+		if(threadPool.stop) break;
+		seen=threadPool.generation;
+		threadPool.active++;
+		pthread_mutex_unlock(&threadPool.lock);
+		
+		runChunks(&threadPool.job);
+		
+		pthread_mutex_lock(&threadPool.lock);
+		if(--threadPool.active==0) pthread_cond_broadcast(&threadPool.done);
 	}
+	
+	pthread_mutex_unlock(&threadPool.lock);
+	return NULL;
+}
+#endif
+
+int buffer_setThreads(int threads) {
+	if(threads<1) threads=1;
+	if(threads>BUFFER_MAX_THREADS) threads=BUFFER_MAX_THREADS;
+	
+#ifdef BUFFER_HAS_THREADS
+	pthread_mutex_lock(&threadPool.busy);
+	
+	// stop the extra workers, which are the last ones started
+	if(threadPool.count>threads-1) {
+		pthread_mutex_lock(&threadPool.lock);
+		threadPool.stop=1;
+		pthread_cond_broadcast(&threadPool.wake);
+		pthread_mutex_unlock(&threadPool.lock);
+		for(int i=0; i<threadPool.count; i++) pthread_join(threadPool.workers[i], NULL);
+		threadPool.stop=0;
+		threadPool.count=0;
+	}
+	
+	// start the missing ones, keeping those that could be started on error
+	while(threadPool.count<threads-1&&!pthread_create(&threadPool.workers[threadPool.count], NULL, workerMain, NULL)) threadPool.count++;
+	
+	atomic_store(&threadCount, threadPool.count+1);
+	pthread_mutex_unlock(&threadPool.busy);
+#endif
+	return buffer_getThreads();
+}
+
+int buffer_parallel(buffer_size_t len, buffer_size_t grain, buffer_task_t task, void* ctx) {
+	if(grain<1) grain=1;
+	
+#ifdef BUFFER_HAS_THREADS
+	// another operation using the pool runs on its own thread instead of waiting
+	if(len/grain>=2&&atomic_load(&threadCount)>1&&!pthread_mutex_trylock(&threadPool.busy)) {
+		int chunks=threadPool.count+1;
+		if(len/grain<(buffer_size_t) chunks) chunks=(int) (len/grain);
+		
+		if(chunks>1) {
+			pthread_mutex_lock(&threadPool.lock);
+			while(threadPool.active>0) pthread_cond_wait(&threadPool.done, &threadPool.lock);
+			threadPool.job.task=task;
+			threadPool.job.ctx=ctx;
+			threadPool.job.len=len;
+			threadPool.job.chunks=chunks;
+			atomic_store(&threadPool.job.next, 0);
+			atomic_store(&threadPool.job.remaining, chunks);
+			threadPool.generation++;
+			pthread_cond_broadcast(&threadPool.wake);
+			pthread_mutex_unlock(&threadPool.lock);
+			
+			runChunks(&threadPool.job);
+			
+			pthread_mutex_lock(&threadPool.lock);
+			while(atomic_load(&threadPool.job.remaining)>0) pthread_cond_wait(&threadPool.done, &threadPool.lock);
+			pthread_mutex_unlock(&threadPool.lock);
+			pthread_mutex_unlock(&threadPool.busy);
+			return chunks;
+		}
+		pthread_mutex_unlock(&threadPool.busy);
+	}
+#endif
+	
+	task(ctx, 0, len, 0);
+	return 1;
 }
@@ -7,16 +7,56 @@
  * please note that any function declared in this library may actually be a macro
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* size type
+ * sizes are stored as size_t, so buffers can be larger than 2GiB
+ * defining BUFFER2_LEGACY_INT when compiling both the library and its users restores the old int sizes, and thus the old struct layout
+ */
+#ifdef BUFFER2_LEGACY_INT
+typedef int buffer_size_t;
+#define BUFFER_SIZE_MAX INT_MAX
+#else
+typedef size_t buffer_size_t;
+#define BUFFER_SIZE_MAX SIZE_MAX
+#endif
+
 /* buffer type definition
- * contains the size, allocated size and position of the buffer
- * its size is 3*sizeof(int)+sizeof(void*), so it should be 24 (with alignment) on a 64bit system
+ * contains the size, allocated size and position of the buffer, as well as flags describing how its memory is managed
+ * its size is 2*sizeof(buffer_size_t)+2*sizeof(int)+sizeof(void*), so it should be 32 on a 64bit system
+ * with BUFFER2_LEGACY_INT, it is 24 on a 64bit system, the flags taking what used to be padding
  */
 typedef struct buffer_t {
-	int size, alloc;
+	buffer_size_t size, alloc;
 	int user;
+	int flags;
 	void* ptr;
 } buffer_t;
 
+/* buffer flags
+ * set by the library to remember how the memory of a buffer must be resized and destroyed
+ * BUFFER_MAPPED: the data is a memory-mapped file
+ * BUFFER_VIEW: the data belongs to another buffer, and the buffer can't be resized
+ * BUFFER_RING: the buffer is the contents of a ring buffer, see buffer_ring_t
+ * BUFFER_MIRRORED: the memory of a ring buffer is mapped twice in a row
+ * BUFFER_INLINE: the data is stored right after the buffer struct, in the same allocation
+ * BUFFER_POOLED: the data is stored in a pool, see buffer_pool_t
+ * BUFFER_HUGEPAGE: large data is aligned on and advised to use transparent huge pages, even after being resized
+ * the bits of BUFFER_ALIGNMENT hold the base 2 logarithm of the alignment of the data, kept when resizing
+ * the bits from BUFFER_PIN up count the pins of the buffer, see buffer_pin
+ */
+#define BUFFER_MAPPED 0x1
+#define BUFFER_VIEW 0x2
+#define BUFFER_RING 0x4
+#define BUFFER_MIRRORED 0x8
+#define BUFFER_INLINE 0x10
+#define BUFFER_POOLED 0x20
+#define BUFFER_HUGEPAGE 0x40
+#define BUFFER_ALIGNMENT 0x1f00
+#define BUFFER_PIN 0x2000
+
 /* struct readers/writers
  * allow reading/writing from a buffer_t pointer
  */
@@ -25,6 +65,8 @@ typedef struct buffer_t {
 #define buffer_getPointer(buf) (((buffer_t*) buf)->ptr)
 #define buffer_getUser(buf) (((buffer_t*) buf)->user)
 #define buffer_setUser(buf, val) ((buffer_t*) buf)->user=val
+#define buffer_getFlags(buf) (((buffer_t*) buf)->flags)
+#define buffer_getAlignment(buf) ((buffer_size_t) 1<<((buffer_getFlags(buf)&BUFFER_ALIGNMENT)>>8))
 
 /* array getters
  * get the array pointed by the buffer
@@ -85,9 +127,15 @@ typedef struct buffer_t {
  * these are NOT to be called to create buffers, and MUST be called on uninitialized buffers
  * you better have a good reason to use these
  */
-buffer_t *buffer_allocData(void* buf, int size, int destroy);
-buffer_t *buffer_callocData(void* buf, int len, int elem, int destroy);
-buffer_t *buffer_wrapData(void* buf, void* ptr, int len);
+buffer_t *buffer_allocData(void* buf, buffer_size_t size, int destroy);
+buffer_t *buffer_callocData(void* buf, buffer_size_t len, buffer_size_t elem, int destroy);
+buffer_t *buffer_allocAlignedData(void* buf, buffer_size_t size, buffer_size_t align, int flags, int destroy);
+buffer_t *buffer_wrapData(void* buf, void* ptr, buffer_size_t len);
+buffer_t *buffer_cloneData(void* buf, const void* src, int destroy);
+buffer_t *buffer_viewData(void* buf, void* parent, buffer_size_t start, buffer_size_t len, int destroy);
+buffer_t *buffer_inlineData(void* buf, buffer_size_t size);
+buffer_t *buffer_mapFileData(void* buf, const char* path, int mode, buffer_size_t size, int destroy);
+buffer_t *buffer_readFileData(void* buf, const char* path, int destroy);
 void buffer_destroyData(void* buf);
 
 /* buffer allocator
@@ -96,8 +144,24 @@ void buffer_destroyData(void* buf);
  */
 #define buffer_alloc(size) buffer_allocData(buffer_allocStruct(), size, 1)
 
+/* inline buffer allocator
+ * creates a buffer whose data is stored right after the struct, so that it only takes one allocation
+ * growing the buffer past its size moves the data to its own allocation
+ * the buffer also needs to be destroyed properly
+ */
+buffer_t *buffer_allocInline(buffer_size_t size);
+
+/* aligned buffer allocator
+ * creates a buffer whose data is aligned on align bytes, which must be a power of two
+ * the alignment is kept when the buffer is resized
+ * buffer_allocAlignedData also accepts the BUFFER_HUGEPAGE flag, to back large buffers with transparent huge pages
+ * the buffer also needs to be destroyed properly
+ */
+#define buffer_allocAligned(size, align) buffer_allocAlignedData(buffer_allocStruct(), size, align, 0, 1)
+
 /* buffer allocator with fill size
  * creates a buffer with a length and an element size, and fills it with zeros
+ * fails if the total size would overflow buffer_size_t
  * the buffer also needs to be destroyed properly
  */
 #define buffer_calloc(len, elem) buffer_callocData(buffer_allocStruct(), len, elem, 1)
@@ -111,6 +175,76 @@ void buffer_destroyData(void* buf);
  */
 #define buffer_wrap(ptr, len) buffer_wrapData(buffer_allocStruct(), ptr, len)
 
+/* buffer cloner
+ * creates a buffer holding a copy of the data of another buffer, with the same user value
+ * the new buffer also needs to be destroyed properly
+ */
+#define buffer_clone(src) buffer_cloneData(buffer_allocStruct(), src, 1)
+
+/* buffer view
+ * creates a buffer aliasing len bytes of another buffer, starting at byte start
+ * the view can't be resized, and pins its parent so that its memory stays in place
+ * returns NULL if the range is empty or out of bounds, or with errno set to EOVERFLOW if parent can't be pinned again, or to EINVAL if it is a ring buffer
+ * once the view is destroyed, its parent must be unpinned with buffer_unpin
+ */
+#define buffer_view(parent, start, len) buffer_viewData(buffer_allocStruct(), parent, start, len, 1)
+
+/* buffer pinning
+ * a pinned buffer keeps its memory in place: resizing it past its allocated size, reserving memory or shrinking it fails
+ * pins are counted, so a buffer stays pinned until it has been unpinned as many times as it has been pinned
+ * this allows keeping pointers inside a buffer, like views do
+ * the count shares the flags, so buffer_canPin must be checked before pinning a buffer an unbounded number of times
+ */
+#define buffer_canPin(buf) (buffer_getFlags(buf)<=INT_MAX-BUFFER_PIN)
+#define buffer_pin(buf) (buffer_getFlags(buf)+=BUFFER_PIN)
+#define buffer_unpin(buf) (buffer_getFlags(buf)-=BUFFER_PIN)
+#define buffer_isPinned(buf) (buffer_getFlags(buf)>=BUFFER_PIN)
+
+/* file mapping modes
+ * BUFFER_MAP_READ: the buffer is read-only, and writing to it crashes
+ * BUFFER_MAP_WRITE: writes go to the file, which is created if needed, and resizing the buffer resizes the file
+ * BUFFER_MAP_PRIVATE: writes are private to the buffer and never reach the file
+ */
+#define BUFFER_MAP_READ 0
+#define BUFFER_MAP_WRITE 1
+#define BUFFER_MAP_PRIVATE 2
+
+/* file mapper
+ * creates a buffer holding the contents of a file, mapped in memory
+ * the size of the buffer is the size of the file
+ * with buffer_mapFileData, a nonzero size maps that many bytes instead, growing the file in BUFFER_MAP_WRITE mode
+ * only BUFFER_MAP_WRITE buffers can grow past their mapped size
+ * returns NULL on error, with errno set
+ * the buffer needs to be destroyed properly, which unmaps the file
+ */
+#define buffer_mapFile(path, mode) buffer_mapFileData(buffer_allocStruct(), path, mode, 0, 1)
+
+/* buffer synchronization
+ * writes the changes to a buffer in BUFFER_MAP_WRITE mode back to its file, and waits for completion
+ * does nothing on other buffers
+ * returns nonzero on success, zero on error, with errno set
+ */
+int buffer_sync(void* buf);
+
+/* file reader
+ * creates a buffer holding a copy of the contents of a file, read in large chunks
+ * files whose size isn't known, like pipes, are read until their end
+ * returns NULL on error, with errno set, which includes empty files as buffers can't be empty
+ * the buffer needs to be destroyed properly
+ */
+#define buffer_readFile(path) buffer_readFileData(buffer_allocStruct(), path, 1)
+
+/* file descriptor I/O
+ * buffer_readFrom reads up to len bytes from a file descriptor into a buffer, starting at byte idx
+ * buffer_writeTo writes len bytes of a buffer to a file descriptor, starting at byte idx
+ * if offset is negative, the current position of the file is used and updated, otherwise the transfer starts at that offset and the position is left untouched
+ * the transfer is done in large chunks, and is retried when interrupted
+ * returns the number of bytes transferred, which is only less than len at the end of the file or after an error
+ * returns BUFFER_NPOS on error if nothing was transferred, with errno set
+ */
+buffer_size_t buffer_readFrom(void* buf, buffer_size_t idx, buffer_size_t len, int fd, long long offset);
+buffer_size_t buffer_writeTo(const void* buf, buffer_size_t idx, buffer_size_t len, int fd, long long offset);
+
 /* buffer destroyer
  * destroys properly a buffer
  * you must always destroy allocated buffers
@@ -121,10 +255,10 @@ void buffer_destroyData(void* buf);
  * sets a buffer's size to a given value
  * always preserves the data
  * note that more memory may actually be allocated
- * also note that resizing to a negative size is undefined behavior
+ * also note that resizing to a zero or negative size fails, as does resizing a view or a ring buffer
  * returns nonzero on success, zero on error
  */
-int buffer_resize(void* buffer, int size);
+buffer_size_t buffer_resize(void* buffer, buffer_size_t size);
 
 /* buffer enlarge
  * enlarges or shrinks a buffer by a said number of bytes
@@ -132,4 +266,218 @@ int buffer_resize(void* buffer, int size);
  */
 #define buffer_enlarge(buf, ammount) buffer_resize(buf, buffer_getSize(buf)+ammount)
 
+/* buffer reserve
+ * makes sure at least size bytes are allocated, without changing the buffer's size
+ * unlike buffer_resize, this allocates exactly what is asked and doesn't apply the growth factor
+ * returns the allocated size on success, zero on error
+ */
+buffer_size_t buffer_reserve(void* buffer, buffer_size_t size);
+
+/* buffer shrinker
+ * releases the memory allocated past the size of the buffer
+ * returns the allocated size on success, zero on error
+ * views and wrapped buffers don't own their memory, so nothing is released and their size is returned
+ */
+buffer_size_t buffer_shrinkToFit(void* buffer);
+
+/* growth factor
+ * when buffer_resize needs more memory, it allocates at least the current allocated size times this factor
+ * this makes repeated calls to buffer_enlarge run in amortized linear time
+ * a factor of 1 or less allocates exactly the requested size, and so does a failed attempt at allocating the grown size
+ * the factor is global to the library, and defaults to BUFFER_DEFAULT_GROWTH
+ */
+#define BUFFER_DEFAULT_GROWTH 1.5
+void buffer_setGrowthFactor(double factor);
+double buffer_getGrowthFactor(void);
+
+/* buffer copy
+ * copies len bytes from src, starting at byte sidx, to dst, starting at byte didx
+ * src and dst may be the same buffer, and the ranges may overlap
+ * large copies between ranges that don't overlap are split between threads, see buffer_setThreads
+ * returns nonzero on success, zero if a range is out of bounds, in which case nothing is copied
+ */
+int buffer_copy(void* dst, buffer_size_t didx, const void* src, buffer_size_t sidx, buffer_size_t len);
+
+/* buffer move
+ * moves len bytes from byte from to byte to inside a buffer, like memmove
+ * returns nonzero on success, zero if a range is out of bounds, in which case nothing is moved
+ */
+#define buffer_move(buf, to, from, len) buffer_copy(buf, to, buf, from, len)
+
+/* search result
+ * returned by the search functions when nothing is found
+ */
+#define BUFFER_NPOS ((buffer_size_t) -1)
+
+/* buffer search
+ * finds the first occurrence of the len bytes at sub in a buffer, starting at byte start
+ * uses SSE2 or AVX2 when available, checked at runtime
+ * returns the offset of the occurrence in bytes, or BUFFER_NPOS if there is none
+ */
+buffer_size_t buffer_find(const void* buf, buffer_size_t start, const void* sub, buffer_size_t len);
+
+/* typed buffer search
+ * finds the first element of elem bytes equal to the one at value, starting at element start
+ * only elements aligned to elem bytes from the start of the buffer are considered
+ * uses SSE2 or AVX2 when available and elem is 1, 2, 4 or 8, checked at runtime
+ * returns the index of the element, or BUFFER_NPOS if there is none
+ */
+buffer_size_t buffer_findValue(const void* buf, buffer_size_t start, const void* value, buffer_size_t elem);
+
+/* byte swapping
+ * reverses the bytes of len elements of elem bytes, starting at element start, converting them between big and little endian
+ * elem must be 1, 2, 4 or 8, the first being a no-op
+ * uses SSSE3 or AVX2 when available, checked at runtime
+ * returns 1 on success, 0 if elem is invalid or the range is out of the buffer
+ */
+int buffer_byteswap(void* buf, buffer_size_t start, buffer_size_t len, buffer_size_t elem);
+
+/* ring buffer type definition
+ * a FIFO of bytes, which starts with a buffer holding its contents, so that it can be used with the other buffer functions
+ * the pointer of the buffer is the oldest byte, its size the number of bytes stored, and its allocated size the capacity of the ring
+ * the contents are always contiguous: when possible the memory is mapped twice in a row, so that the end of the ring continues at its start
+ * otherwise, the contents are moved back to the start of the memory when there isn't enough room after them
+ * the buffer can't be resized, only pushed to and consumed from
+ */
+typedef struct buffer_ring_t {
+	buffer_t buf;
+	void* base;
+} buffer_ring_t;
+
+/* ring buffer creator
+ * creates an empty ring buffer holding at least capacity bytes, and returns a pointer to it
+ * the capacity is rounded up to the page size when the memory can be mapped twice
+ * returns NULL on error
+ * the ring needs to be destroyed properly, either with buffer_ringDestroy or buffer_destroy
+ */
+buffer_ring_t *buffer_ringCreateData(void* ring, buffer_size_t capacity, int destroy);
+#define buffer_ringCreate(capacity) buffer_ringCreateData(malloc(sizeof(buffer_ring_t)), capacity, 1)
+#define buffer_ringDestroy(ring) buffer_destroy(ring)
+
+/* ring buffer accessors
+ * the stored bytes start at buffer_getPointer(ring) and are contiguous
+ */
+#define buffer_ringGetLength(ring) buffer_getSize(ring)
+#define buffer_ringGetCapacity(ring) buffer_getAllocatedSize(ring)
+#define buffer_ringGetFree(ring) (buffer_getAllocatedSize(ring)-buffer_getSize(ring))
+
+/* ring buffer writers
+ * buffer_ringReserve makes room for len more bytes, growing the ring if needed, and returns where to write them, or NULL on error
+ * a pinned ring can't grow, so reserving more than its free room fails with errno set to EBUSY
+ * buffer_ringCommit then adds len written bytes at the end of the ring, which must fit in the reserved room
+ * buffer_ringPush does both and copies len bytes from data, and returns nonzero on success, zero on error
+ */
+void* buffer_ringReserve(buffer_ring_t* ring, buffer_size_t len);
+#define buffer_ringCommit(ring, len) (buffer_getSize(ring)+=(len))
+int buffer_ringPush(buffer_ring_t* ring, const void* data, buffer_size_t len);
+
+/* ring buffer readers
+ * buffer_ringPeek copies up to len of the oldest bytes to dst without removing them, and returns the number of bytes copied
+ * buffer_ringConsume removes up to len of the oldest bytes, and returns the number of bytes removed
+ * buffer_ringPop does both
+ */
+buffer_size_t buffer_ringPeek(const buffer_ring_t* ring, void* dst, buffer_size_t len);
+buffer_size_t buffer_ringConsume(buffer_ring_t* ring, buffer_size_t len);
+buffer_size_t buffer_ringPop(buffer_ring_t* ring, void* dst, buffer_size_t len);
+
+/* single-producer single-consumer queue
+ * a lock-free FIFO of bytes with a fixed capacity, for handing data from one thread to another
+ * exactly one thread may call the producer functions, and exactly one thread the consumer functions
+ * the indices of each side live on their own cache line, and each side only reads the index of the other when it runs out of room or data
+ * the type is opaque, as it uses C11 atomics
+ */
+typedef struct buffer_spsc_t buffer_spsc_t;
+
+/* queue creator and destroyer
+ * creates an empty queue holding at least capacity bytes, rounded up to a power of two, and returns a pointer to it
+ * returns NULL on error
+ * the queue must be destroyed once neither thread uses it anymore
+ */
+buffer_spsc_t *buffer_spscCreate(buffer_size_t capacity);
+void buffer_spscDestroy(buffer_spsc_t* queue);
+
+/* queue accessors
+ * the length is only a snapshot when called while the other thread is running
+ */
+buffer_size_t buffer_spscGetCapacity(const buffer_spsc_t* queue);
+buffer_size_t buffer_spscGetLength(buffer_spsc_t* queue);
+
+/* queue producer
+ * buffer_spscReserve returns where to write the next bytes; len holds the number of bytes wanted, and is set to the number of contiguous free bytes, which may be more or less
+ * buffer_spscCommit publishes len bytes written there to the consumer, so a batch of writes costs a single synchronization
+ * buffer_spscPush does both and copies up to len bytes from data, and returns the number of bytes copied
+ */
+void* buffer_spscReserve(buffer_spsc_t* queue, buffer_size_t* len);
+void buffer_spscCommit(buffer_spsc_t* queue, buffer_size_t len);
+buffer_size_t buffer_spscPush(buffer_spsc_t* queue, const void* data, buffer_size_t len);
+
+/* queue consumer
+ * buffer_spscPeek returns where the oldest bytes are; len holds the number of bytes wanted, and is set to the number of contiguous bytes available, which may be more or less
+ * buffer_spscConsume releases len of these bytes to the producer
+ * buffer_spscPop does both and copies up to len bytes to dst, and returns the number of bytes copied
+ * bytes are contiguous up to the end of the queue, or always when the memory could be mapped twice like ring buffers
+ */
+const void* buffer_spscPeek(buffer_spsc_t* queue, buffer_size_t* len);
+void buffer_spscConsume(buffer_spsc_t* queue, buffer_size_t len);
+buffer_size_t buffer_spscPop(buffer_spsc_t* queue, void* dst, buffer_size_t len);
+
+/* buffer pool
+ * an arena which allocates small buffers from size-class freelists, carved from large blocks
+ * sizes up to BUFFER_POOL_MAX bytes are pooled, larger ones are allocated normally
+ * a pool isn't thread-safe, and must outlive the buffers allocated from it
+ * the type is opaque
+ */
+#define BUFFER_POOL_MAX 4096
+typedef struct buffer_pool_t buffer_pool_t;
+
+/* pool creator and destroyer
+ * buffer_poolCreate returns NULL on error
+ * buffer_poolDestroy releases all the memory of a pool, like buffer_poolReset
+ */
+buffer_pool_t *buffer_poolCreate(void);
+void buffer_poolDestroy(buffer_pool_t* pool);
+
+/* pool allocator
+ * buffer_poolAlloc creates an inline buffer in a pool, with its struct and data in the same block, which is released with buffer_poolFree
+ * buffer_poolAllocData allocates the data portion of an uninitialized buffer from a pool, which is released by buffer_destroyData
+ * growing a pooled buffer past the capacity of its block moves its data to its own allocation
+ * both return NULL on error
+ */
+buffer_t *buffer_poolAlloc(buffer_pool_t* pool, buffer_size_t size);
+buffer_t *buffer_poolAllocData(void* buf, buffer_pool_t* pool, buffer_size_t size, int destroy);
+void buffer_poolFree(void* buf);
+
+/* pool reset
+ * releases at once all the buffers allocated from a pool, keeping its memory for the next allocations
+ * the data that buffers from buffer_poolAlloc moved to their own allocation is freed
+ * buffers from the pool must not be used nor destroyed afterwards
+ */
+void buffer_poolReset(buffer_pool_t* pool);
+
+/* parallel execution
+ * large range operations can be split into chunks run by an internal pool of threads
+ * buffer_setThreads sets how many threads run an operation, counting the calling one, up to BUFFER_MAX_THREADS
+ * it defaults to 1, which doesn't start any thread, and returns the number actually available, which is always 1 without pthreads
+ * the pool is global to the library, and runs one operation at a time; others run on their calling thread meanwhile
+ * the threads must be stopped by setting the number back to 1 before unloading the library
+ */
+#define BUFFER_MAX_THREADS 64
+int buffer_setThreads(int threads);
+int buffer_getThreads(void);
+
+/* parallel loop
+ * calls task(ctx, first, last, chunk) on consecutive ranges covering [0, len), each one at least grain long
+ * chunks are numbered from 0 in order, and there are at most buffer_getThreads() of them, so partial results can be stored per chunk
+ * a range shorter than twice the grain runs as a single chunk on the calling thread
+ * returns the number of chunks, once all of them have completed
+ */
+typedef void (*buffer_task_t)(void* ctx, buffer_size_t first, buffer_size_t last, int chunk);
+int buffer_parallel(buffer_size_t len, buffer_size_t grain, buffer_task_t task, void* ctx);
+
+/* parallel grain
+ * the number of bytes below which splitting an operation costs more than it saves, as waking threads takes a few microseconds
+ * buffer_copy and the Lua kernels split ranges in chunks of at least this size
+ */
+#define BUFFER_PARALLEL_GRAIN ((buffer_size_t) 1<<20)
+
 #endif //_BUFFER2_H
@@ -6,22 +6,66 @@
 
 /**
  * list of functions in the main library:
- * new: creates a buffer
+ * new: creates a buffer, optionally from a pool or inside its own object
+ * pool: creates a pool for small buffers
  * calloc: creates a buffer filled with zeroes
+ * fromstring: creates a buffer holding the bytes of a string
+ * mmap: creates a buffer by mapping a file in memory
+ * sync: writes the changes to a mapped buffer back to its file
+ * readfile: creates a buffer holding a copy of a file
+ * readfrom: reads from a file into a buffer
+ * writeto: writes a range of a buffer to a file
+ * columns: creates a set of typed buffers sharing a length, one per field of a record
+ * ring: creates a ring buffer
+ * spsc: creates or wraps a lock-free queue filled by another thread
+ * clone: creates a buffer holding a copy of a range of another
+ * copy: copies a range of a buffer into another
+ * internalcopy: copies a range of a buffer inside itself
+ * view: creates a buffer aliasing a range of another
+ * find: finds a sequence of bytes or a value
+ * findall: finds all the occurrences of a sequence of bytes or a value
+ * sum, min, max, fill, scale, add, dot: numeric kernels over a range
+ * foreach: calls a function for each value of a range
+ * map: replaces each value of a range with the result of a function
+ * convert: converts values from a type to another, into another buffer
+ * sort: sorts a range in place
+ * argsort: returns the indices which sort a range
+ * bsearch: finds where a value belongs in a sorted range
+ * byteswap: reverses the bytes of each value of a range
+ * unpack: reads a record made of several values, described by a format
+ * pack: writes a record made of several values, described by a format
+ * unpackmany: reads consecutive records into one buffer per field
+ * readstring: reads a range of bytes as a string
+ * writestring: writes the bytes of a string
  * getsize: returns the size of a buffer
  * setsize: resizes a buffer
+ * getcapacity: returns the allocated size of a buffer
+ * reserve: makes sure a buffer has at least a given allocated size
+ * shrink: releases the memory allocated past the size of a buffer
+ * getgrowth: returns the growth factor used when resizing buffers
+ * setgrowth: sets the growth factor used when resizing buffers
+ * getthreads: returns the number of threads running large kernels, conversions and copies
+ * setthreads: sets the number of threads running large kernels, conversions and copies
  * getlength: returns the length of a buffer used as an array
  * setlength: resizes a buffer so that its length would be a specific value
  * gettype: returns the type of the array
  * settype: sets the type of the array
  * get: returns the value at a given index, of a given type
  * set: sets the value at a given index, of a given type
+ * getat: returns the value at a given byte offset, of a given type
+ * setat: sets the value at a given byte offset, of a given type
+ * getter: returns a function reading values of a given type
+ * setter: returns a function writing values of a given type
+ * totable: reads a range of values into a table
+ * fromtable: writes the values of a table
+ * setrange: writes its arguments as consecutive values
  * iter: an iterator which can be used on any table-like object
  */
 
 /**
  * list of properties of buffer objects:
  * size: the size of the buffer, in bytes
+ * capacity: the allocated size of the buffer, in bytes (read-only)
  * length: the length of the buffer used as an array
  * type: the type of objects stored in the buffer, when used as an array
  */
@@ -30,24 +74,101 @@
  * list of methods on buffer objects:
  * getsize: returns its size property
  * setsize: sets its size property
+ * getcapacity: returns its capacity property
+ * reserve: makes sure its capacity is at least a given size
+ * shrink: reduces its capacity to its size
  * getlength: returns its length property
  * setlength: sets its length property
  * gettype: returns its type property
  * settype: sets its type property
  * get: reads at a given index, as a given type
  * set: writes at a given index, as a given type
+ * getat: reads at a given byte offset, as a given type
+ * setat: writes at a given byte offset, as a given type
+ * getter: returns a function reading values of a given type
+ * setter: returns a function writing values of a given type
+ * totable: reads a range as a table
+ * fromtable: writes the values of a table
+ * setrange: writes its arguments as consecutive values
+ * sync: writes the changes back to its file, if it is mapped
+ * readfrom: reads from a file into it
+ * writeto: writes a range to a file
+ * readstring: reads a range of bytes as a string
+ * writestring: writes the bytes of a string
+ * clone: creates a copy of a range
+ * copy: copies a range into another buffer
+ * internalcopy: copies a range inside the buffer
+ * view: creates a buffer aliasing a range, without copying it
+ * find: finds a sequence of bytes or a value
+ * findall: finds all the occurrences of a sequence of bytes or a value
+ * sum, min, max, fill, scale, add, dot: numeric kernels over a range
+ * foreach: calls a function for each value of a range
+ * map: replaces each value of a range with the result of a function
+ * convert: converts values from a type to another, into another buffer
+ * sort: sorts a range in place
+ * argsort: returns the indices which sort a range
+ * bsearch: finds where a value belongs in a sorted range
+ * byteswap: reverses the bytes of each value of a range
+ * unpack: reads a record at a byte offset
+ * pack: writes a record at a byte offset
+ * unpackmany: reads consecutive records into one buffer per field
  * @remark other functions from the main library will be available as buffer methods, but will cause undefined behavior if called an potentially throw
  */
 
+/**
+ * list of methods on ring buffer objects:
+ * push: adds bytes at its end
+ * peek: reads bytes from its start
+ * pop: reads and removes bytes from its start
+ * consume: removes bytes from its start
+ * find: finds a sequence of bytes
+ * readfrom: reads from a file at its end
+ * writeto: writes bytes from its start to a file, and removes them
+ * getcapacity: returns the number of bytes it can hold without growing
+ * #ring: returns the number of bytes it holds
+ */
+
+/**
+ * list of methods on columns objects:
+ * append: adds a row at the end
+ * get: reads a row as a table
+ * set: writes a row
+ * column: returns the buffer of a field
+ * names: returns the names of the fields, in the order of the columns
+ * #columns: returns the number of rows
+ */
+
+/**
+ * list of methods on queue objects, which are the consumer side of a buffer_spsc_t:
+ * pop: reads and removes bytes
+ * popinto: reads and removes bytes into a buffer
+ * consume: removes bytes
+ * getcapacity: returns the number of bytes it can hold
+ * pointer: returns the queue as a light userdata, to give it to a producer
+ * #queue: returns the number of bytes it holds
+ */
+
 #include "lua.h"
 #include "lauxlib.h"
 #include "lualib.h"
 
 #include "buffer2.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
+
+// __freading, to tell input streams from output streams
+#ifdef __linux__
+#include <stdio_ext.h>
+#endif
+
+#if defined(__GNUC__)&&defined(__x86_64__)
+#define BUFFER_X86_SIMD
+#endif
 
 // function type markers
 #define API static
@@ -61,8 +182,88 @@
 #define typename(sgn, name) T_##sgn##name
 #define typeid(name) TYPE_##name
 
-// class name
+// class names
 #define BUFFER_CLASS "buffer2"
+#define INLINE_CLASS "buffer2.inline"
+#define RING_CLASS "buffer2.ring"
+#define SPSC_CLASS "buffer2.spsc"
+#define POOL_CLASS "buffer2.pool"
+#define COLUMNS_CLASS "buffer2.columns"
+
+// registry key of the type name cache, which maps type names to types
+static const char typeCacheKey='t';
+
+// registry key of the object stopping the threads when the state is closed
+static const char threadsKey='p';
+
+// registry key of the format cache, which maps format strings to compiled formats
+static const char formatCacheKey='f';
+
+// queue reference struct, as queues are opaque and may belong to C code
+typedef struct {
+	buffer_spsc_t *queue;
+	int owned;
+} spscref_t;
+
+// compiled record format, a list of typed fields at byte offsets
+typedef struct {
+	int count;
+	int size;
+	struct {
+		int type;
+		int offset;
+	} fields[];
+} format_t;
+
+// columns struct, whose buffers are kept alive by its uservalue, along with the names of the fields
+typedef struct {
+	lua_Integer length;
+	int count;
+	struct {
+		buffer_t *buf;
+		int type;
+		int size;
+	} columns[];
+} columns_t;
+
+// arguments of a numeric kernel, whose range is split in chunks by buffer_parallel
+// p and q point to the first element of the range in each buffer, and results holds a result per chunk
+typedef union {
+	lua_Unsigned integer;
+	lua_Number number;
+} accumulator_t;
+typedef struct {
+	char *p;
+	const char *q;
+	int mode;
+	accumulator_t val;
+	accumulator_t results[BUFFER_MAX_THREADS];
+} kernel_t;
+
+// specialized conversion between two kinds of types, see convertKind
+#define KIND_U8 0
+#define KIND_S16 1
+#define KIND_S32 2
+#define KIND_FLOAT 3
+#define KIND_DOUBLE 4
+typedef void (*convertFn)(void *restrict dst, const void *restrict src, buffer_size_t n, lua_Number scale);
+typedef struct {
+	int src, dst;
+	int saturating;
+	convertFn fn;
+} conversion_t;
+
+// arguments of a conversion, whose range is split in chunks by buffer_parallel
+// fast is the specialized conversion between both types, if there is one
+typedef struct {
+	const char *src;
+	char *dst;
+	int srctype, dsttype;
+	int integer;
+	int saturate;
+	accumulator_t scale;
+	convertFn fast;
+} convertjob_t;
 
 // findstr struct
 typedef struct {
@@ -74,6 +275,16 @@ typedef struct {
 #define TYPE_UNSIGNED 0x00
 #define TYPE_SIGNED 0x10
 
+// byte order, relative to the native one
+#define TYPE_SWAPPED 0x20
+#if defined(__BYTE_ORDER__)&&__BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+#define TYPE_BE 0x00
+#define TYPE_LE TYPE_SWAPPED
+#else
+#define TYPE_BE TYPE_SWAPPED
+#define TYPE_LE 0x00
+#endif
+
 // standard types
 #define TYPE_CHAR 0x0
 #define T_UCHAR unsigned char
@@ -135,6 +346,101 @@ typedef struct {
 #define T_U64 uint64_t
 #define T_S64 int64_t
 #endif
+
+// type used for buffers of indices
+#if defined(TYPE_64)
+#define TYPE_INDEX (TYPE_SIGNED|TYPE_64)
+#define T_INDEX T_S64
+#elif defined(TYPE_32)
+#define TYPE_INDEX (TYPE_SIGNED|TYPE_32)
+#define T_INDEX T_S32
+#else
+#error "Lua integers are too small to hold buffer indices"
+#endif
+
+// floating-point types, whatever their sign and byte order
+#ifdef TYPE_DOUBLE
+#define isFloatType(type) (((type)&0xf)==TYPE_FLOAT||((type)&0xf)==TYPE_DOUBLE)
+#else
+#define isFloatType(type) (((type)&0xf)==TYPE_FLOAT)
+#endif
+
+// type iteration
+// forEachType(m) expands to m(type, sgn, luatype) for every available type, signed and unsigned
+#define typecode(type, sgn) (typeid(type)|SIGN_##sgn)
+#define SIGN_S TYPE_SIGNED
+#define SIGN_U TYPE_UNSIGNED
+
+#ifdef TYPE_SHORT
+#define ifSHORT(x) x
+#else
+#define ifSHORT(x)
+#endif
+#ifdef TYPE_INT
+#define ifINT(x) x
+#else
+#define ifINT(x)
+#endif
+#ifdef TYPE_LONG
+#define ifLONG(x) x
+#else
+#define ifLONG(x)
+#endif
+#ifdef TYPE_LONGLONG
+#define ifLONGLONG(x) x
+#else
+#define ifLONGLONG(x)
+#endif
+#ifdef TYPE_DOUBLE
+#define ifDOUBLE(x) x
+#else
+#define ifDOUBLE(x)
+#endif
+#ifdef TYPE_16
+#define if16(x) x
+#else
+#define if16(x)
+#endif
+#ifdef TYPE_32
+#define if32(x) x
+#else
+#define if32(x)
+#endif
+#ifdef TYPE_64
+#define if64(x) x
+#else
+#define if64(x)
+#endif
+
+#define forEachType(m) \
+	m(CHAR, S, integer) m(CHAR, U, integer) \
+	ifSHORT(m(SHORT, S, integer) m(SHORT, U, integer)) \
+	ifINT(m(INT, S, integer) m(INT, U, integer)) \
+	ifLONG(m(LONG, S, integer) m(LONG, U, integer)) \
+	ifLONGLONG(m(LONGLONG, S, integer) m(LONGLONG, U, integer)) \
+	m(FLOAT, S, number) m(FLOAT, U, number) \
+	ifDOUBLE(m(DOUBLE, S, number) m(DOUBLE, U, number)) \
+	m(8, S, integer) m(8, U, integer) \
+	if16(m(16, S, integer) m(16, U, integer)) \
+	if32(m(32, S, integer) m(32, U, integer)) \
+	if64(m(64, S, integer) m(64, U, integer))
+
+// forEachSwappedType(m) does the same for the types which can be stored in the opposite byte order
+// these are the fixed-width and floating-point ones, whose codes have TYPE_SWAPPED set
+#define swappedcode(type, sgn) (typecode(type, sgn)|TYPE_SWAPPED)
+#define forEachSwappedType(m) \
+	m(FLOAT, S, number) m(FLOAT, U, number) \
+	ifDOUBLE(m(DOUBLE, S, number) m(DOUBLE, U, number)) \
+	if16(m(16, S, integer) m(16, U, integer)) \
+	if32(m(32, S, integer) m(32, U, integer)) \
+	if64(m(64, S, integer) m(64, U, integer))
+
+// size of each type, indexed by type
+#define typeSizeEntry(type, sgn, luatype) [typecode(type, sgn)]=sizeof(typename(sgn, type)),
+#define swappedSizeEntry(type, sgn, luatype) [swappedcode(type, sgn)]=sizeof(typename(sgn, type)),
+static const unsigned char typeSizes[0x40]={forEachType(typeSizeEntry) forEachSwappedType(swappedSizeEntry)};
+#undef typeSizeEntry
+#undef swappedSizeEntry
 //END type constants
 
 //BEGIN function prototypes
@@ -143,20 +449,81 @@ typedef struct {
 ENTRYPOINT int luaopen_buffer2(lua_State *L);
 INTERNAL int setupMeta(lua_State *L);
 INTERNAL int setupLib(lua_State *L);
+INTERNAL int setupRing(lua_State *L);
+INTERNAL int setupSpsc(lua_State *L);
+INTERNAL int setupPool(lua_State *L);
+INTERNAL int setupColumns(lua_State *L);
 
 // internal functions
 INTERNAL int isValidType(int type);
 INTERNAL buffer_t *bufferFromArg(lua_State *L);
+INTERNAL buffer_t *bufferAt(lua_State *L, int arg);
+INTERNAL buffer_t *testBuffer(lua_State *L, int arg);
+INTERNAL buffer_t *metaBuffer(lua_State *L, int upvalue);
+INTERNAL void checkInline(lua_State *L, int arg, buffer_t *buf);
+INTERNAL buffer_t *pushBuffer(lua_State *L, buffer_size_t size);
+INTERNAL buffer_t *newBuffer(lua_State *L, buffer_size_t size, int arg);
+INTERNAL buffer_ring_t *ringFromArg(lua_State *L);
+INTERNAL buffer_spsc_t *spscFromArg(lua_State *L);
 INTERNAL int typeFromArg(lua_State *L, buffer_t *buf, int arg);
+INTERNAL int nativeTypeFromArg(lua_State *L, buffer_t *buf, int arg);
+INTERNAL int parseType(const char* str);
 INTERNAL int startswith(const char* str, const char* beginning);
 INTERNAL int findstr(const char* str, findstr_t* list);
-INTERNAL int getLength(buffer_t *buf, int type);
+INTERNAL lua_Integer getLength(buffer_t *buf, int type);
+INTERNAL buffer_size_t sizeFromArg(lua_State *L, int arg);
+INTERNAL lua_Integer rangeFromArgs(lua_State *L, lua_Integer len, int arg, lua_Integer *first);
+INTERNAL lua_Integer integerAt(lua_State *L, int idx, lua_Integer pos);
+INTERNAL lua_Number numberAt(lua_State *L, int idx, lua_Integer pos);
+INTERNAL int needleFromArg(lua_State *L, int arg, int type, const char **needle, size_t *len, char *value);
+INTERNAL void swapValue(void *dst, const void *src, int size);
+INTERNAL void pushValue(lua_State *L, buffer_t *buf, int type, lua_Integer idx);
+INTERNAL lua_Unsigned wrapInteger(lua_Number val);
+INTERNAL int findExtremum(lua_State *L, int max);
+INTERNAL void storeValue(lua_State *L, buffer_t *buf, int type, lua_Integer idx, int arg);
+INTERNAL lua_Integer storeValues(lua_State *L, buffer_t *buf, int type, lua_Integer first, lua_Integer n, int src, int fromTable);
+INTERNAL void pushValueAt(lua_State *L, const char *ptr, int type);
+INTERNAL void storeValueAt(lua_State *L, char *ptr, int type, int arg);
 INTERNAL int typeSize(int type);
+INTERNAL FILE *fileFromArg(lua_State *L, int arg, int *fd);
+INTERNAL void syncFile(FILE *file);
+INTERNAL format_t *compileFormat(lua_State *L, const char *str);
+INTERNAL const format_t *formatFromArg(lua_State *L, int arg);
+INTERNAL void gatherColumn(char *dst, const char *src, lua_Integer n, int size, int stride);
+INTERNAL columns_t *columnsFromArg(lua_State *L);
+INTERNAL void checkColumns(lua_State *L, columns_t *cols);
+INTERNAL int resizeColumns(columns_t *cols, lua_Integer length);
+INTERNAL void checkRow(lua_State *L, columns_t *cols, int src, int named);
+INTERNAL void storeRow(lua_State *L, columns_t *cols, lua_Integer row, int src, int named);
+INTERNAL int runKernel(buffer_task_t task, kernel_t *kernel, lua_Integer n, int type);
+INTERNAL void loadNumbers(lua_Number *tmp, const char *src, int type, int n);
+INTERNAL void loadIntegers(lua_Integer *tmp, const char *src, int type, int n);
+INTERNAL void storeNumbers(char *dst, int type, const lua_Number *tmp, int n, int saturate);
+INTERNAL void storeIntegers(char *dst, int type, const lua_Integer *tmp, int n, int saturate);
+INTERNAL int convertKind(int type);
+INTERNAL convertFn findConversion(int srctype, int dsttype, int saturate);
+#ifdef BUFFER_X86_SIMD
+INTERNAL void resolveConversions(void);
+#endif
+INTERNAL void convertTask(void* ctx, buffer_size_t first, buffer_size_t last, int chunk);
+INTERNAL int sortDepth(size_t n);
 
 // size (in bytes) getter/setter
 API int api_bufferGetSize(lua_State *L);
 API int api_bufferSetSize(lua_State *L);
 
+// capacity (in bytes) management
+API int api_bufferGetCapacity(lua_State *L);
+API int api_bufferReserve(lua_State *L);
+API int api_bufferShrink(lua_State *L);
+API int api_bufferGetGrowth(lua_State *L);
+API int api_bufferSetGrowth(lua_State *L);
+
+// threads
+API int api_bufferGetThreads(lua_State *L);
+API int api_bufferSetThreads(lua_State *L);
+API int meta_threadsGc(lua_State *L);
+
 // length (according to type) getter/setter
 API int api_bufferGetLength(lua_State *L);
 API int api_bufferSetLength(lua_State *L);
@@ -168,10 +535,108 @@ API int api_bufferSetType(lua_State *L);
 // value getter/setter
 API int api_bufferGet(lua_State *L);
 API int api_bufferSet(lua_State *L);
+API int api_bufferGetAt(lua_State *L);
+API int api_bufferSetAt(lua_State *L);
+
+// bulk value getter/setter
+API int api_bufferToTable(lua_State *L);
+API int api_bufferFromTable(lua_State *L);
+API int api_bufferSetRange(lua_State *L);
 
 // buffer creator
 API int api_bufferNew(lua_State *L);
 API int api_bufferCalloc(lua_State *L);
+API int api_bufferPool(lua_State *L);
+API int meta_poolGc(lua_State *L);
+
+// memory-mapped files
+API int api_bufferMmap(lua_State *L);
+API int api_bufferSync(lua_State *L);
+
+// file I/O
+API int api_bufferReadFile(lua_State *L);
+API int api_bufferReadFrom(lua_State *L);
+API int api_bufferWriteTo(lua_State *L);
+
+// copy
+API int api_bufferClone(lua_State *L);
+API int api_bufferCopy(lua_State *L);
+API int api_bufferInternalCopy(lua_State *L);
+
+// views
+API int api_bufferView(lua_State *L);
+
+// search
+API int api_bufferFind(lua_State *L);
+API int api_bufferFindAll(lua_State *L);
+
+// specialized accessors
+API int api_bufferGetter(lua_State *L);
+API int api_bufferSetter(lua_State *L);
+
+// numeric kernels
+API int api_bufferSum(lua_State *L);
+API int api_bufferMin(lua_State *L);
+API int api_bufferMax(lua_State *L);
+API int api_bufferFill(lua_State *L);
+API int api_bufferScale(lua_State *L);
+API int api_bufferAdd(lua_State *L);
+API int api_bufferDot(lua_State *L);
+API int api_bufferForeach(lua_State *L);
+API int api_bufferMap(lua_State *L);
+
+// type conversion
+API int api_bufferConvert(lua_State *L);
+
+// sorting
+API int api_bufferSort(lua_State *L);
+API int api_bufferArgsort(lua_State *L);
+API int api_bufferBsearch(lua_State *L);
+
+// byte order
+API int api_bufferByteswap(lua_State *L);
+
+// records
+API int api_bufferUnpack(lua_State *L);
+API int api_bufferPack(lua_State *L);
+API int api_bufferUnpackMany(lua_State *L);
+
+// string conversion
+API int api_bufferReadString(lua_State *L);
+API int api_bufferWriteString(lua_State *L);
+API int api_bufferFromString(lua_State *L);
+
+// ring buffers
+API int api_ringNew(lua_State *L);
+API int api_ringPush(lua_State *L);
+API int api_ringPeek(lua_State *L);
+API int api_ringPop(lua_State *L);
+API int api_ringConsume(lua_State *L);
+API int api_ringFind(lua_State *L);
+API int api_ringReadFrom(lua_State *L);
+API int api_ringWriteTo(lua_State *L);
+API int api_ringGetCapacity(lua_State *L);
+API int meta_ringLen(lua_State *L);
+API int meta_ringGc(lua_State *L);
+
+// columns
+API int api_columnsNew(lua_State *L);
+API int api_columnsAppend(lua_State *L);
+API int api_columnsGet(lua_State *L);
+API int api_columnsSet(lua_State *L);
+API int api_columnsColumn(lua_State *L);
+API int api_columnsNames(lua_State *L);
+API int meta_columnsLen(lua_State *L);
+
+// lock-free queues
+API int api_spscNew(lua_State *L);
+API int api_spscPop(lua_State *L);
+API int api_spscPopInto(lua_State *L);
+API int api_spscConsume(lua_State *L);
+API int api_spscGetCapacity(lua_State *L);
+API int api_spscPointer(lua_State *L);
+API int meta_spscLen(lua_State *L);
+API int meta_spscGc(lua_State *L);
 
 // metamethods
 API int meta_index(lua_State *L);
@@ -194,7 +659,10 @@ OTHER int other_iter(lua_State *L);
  */
 int isValidType(int type) {
 	// check if there are illegal bits
-	if((type&0x1f)!=type) return 0;
+	if((type&0x3f)!=type) return 0;
+	
+	// only some types have a byte order
+	if(type&TYPE_SWAPPED) return typeSizes[type]!=0;
 	
 	// check individual types
 	switch(type&0xf) {
@@ -251,7 +719,174 @@ int isValidType(int type) {
  * @returns buffer_t*, a pointer to the buffer_t
  */
 buffer_t *bufferFromArg(lua_State *L) {
-	return luaL_checkudata(L, 1, BUFFER_CLASS);
+	return bufferAt(L, 1);
+}
+
+/**
+ * @name bufferAt
+ * unwraps the buffer_t contained in Lua arg#arg
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @returns buffer_t*, a pointer to the buffer_t
+ */
+buffer_t *bufferAt(lua_State *L, int arg) {
+	buffer_t *buf=testBuffer(L, arg);
+	if(buf==NULL) return luaL_checkudata(L, arg, BUFFER_CLASS);
+	return buf;
+}
+
+/**
+ * @name testBuffer
+ * unwraps the buffer_t contained in Lua arg#arg, if it is a buffer
+ * inline buffers have their own class, which only lacks __gc
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @returns buffer_t*, a pointer to the buffer_t, or NULL if the argument isn't a buffer
+ */
+buffer_t *testBuffer(lua_State *L, int arg) {
+	buffer_t *buf=luaL_testudata(L, arg, BUFFER_CLASS);
+	if(buf==NULL) buf=luaL_testudata(L, arg, INLINE_CLASS);
+	return buf;
+}
+
+/**
+ * @name metaBuffer
+ * unwraps the buffer_t contained in Lua arg1 for the fast paths of metamethods, which can also be called directly from Lua
+ * it compares the metatable of the argument to the ones held in two upvalues, which is cheaper than testBuffer
+ * @param L: lua_State, the Lua instance
+ * @param upvalue: int, the index of the upvalue holding the metatable of buffers, followed by the one of inline buffers
+ * @returns buffer_t*, a pointer to the buffer_t, or NULL if the argument isn't a buffer
+ */
+buffer_t *metaBuffer(lua_State *L, int upvalue) {
+	if(lua_type(L, 1)!=LUA_TUSERDATA||!lua_getmetatable(L, 1)) return NULL;
+	int isbuf=lua_rawequal(L, -1, lua_upvalueindex(upvalue))||lua_rawequal(L, -1, lua_upvalueindex(upvalue+1));
+	lua_pop(L, 1);
+	return isbuf?lua_touserdata(L, 1):NULL;
+}
+
+/**
+ * @name checkInline
+ * gives back __gc to an inline buffer in Lua arg#arg whose data has moved to the heap
+ * to be called after anything that may grow a buffer
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @param buf: buffer_t*, the buffer in this argument
+ */
+void checkInline(lua_State *L, int arg, buffer_t *buf) {
+	if(buffer_getFlags(buf)&BUFFER_INLINE) return;
+	if(luaL_testudata(L, arg, INLINE_CLASS)==NULL) return;
+	lua_pushvalue(L, arg);
+	luaL_setmetatable(L, BUFFER_CLASS);
+	lua_pop(L, 1);
+}
+
+/**
+ * @name pushBuffer
+ * creates a buffer of a given size in char mode and pushes it on the stack
+ * its content is left uninitialized
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param size: buffer_size_t, the size of the buffer
+ * @returns buffer_t*, a pointer to the buffer_t
+ */
+buffer_t *pushBuffer(lua_State *L, buffer_size_t size) {
+	buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+	if(!buffer_allocData(buf, size, 0)) {
+		buf->alloc=0;
+		luaL_error(L, "failed to allocate buffer");
+		return NULL;
+	}
+	luaL_setmetatable(L, BUFFER_CLASS);
+	return buf;
+}
+
+/**
+ * @name newBuffer
+ * creates a buffer of a given size in char mode following the options in Lua arg#arg, and pushes it on the stack
+ * the options are either nil, a pool, or a table with the optional fields pool, inline, align and hugepage
+ * inline buffers hold their data in the Lua object itself and have no finalizer until they grow
+ * aligned and huge page buffers keep these properties when resized
+ * its content is left uninitialized
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param size: buffer_size_t, the size of the buffer
+ * @param arg: int, the index of the options
+ * @returns buffer_t*, a pointer to the buffer_t
+ */
+buffer_t *newBuffer(lua_State *L, buffer_size_t size, int arg) {
+	arg=lua_absindex(L, arg);
+	if(lua_isnoneornil(L, arg)) return pushBuffer(L, size);
+	
+	// read the options, leaving the pool on top of the stack
+	int inlined=0, flags=0;
+	lua_Integer align=0;
+	if(lua_istable(L, arg)) {
+		lua_getfield(L, arg, "inline");
+		inlined=lua_toboolean(L, -1);
+		lua_getfield(L, arg, "hugepage");
+		if(lua_toboolean(L, -1)) flags|=BUFFER_HUGEPAGE;
+		lua_getfield(L, arg, "align");
+		if(!lua_isnil(L, -1)) {
+			int isint;
+			align=lua_tointegerx(L, -1, &isint);
+			if(!isint||align<=0||align&(align-1)) luaL_argerror(L, arg, "align must be a power of two");
+		}
+		lua_getfield(L, arg, "pool");
+		lua_replace(L, -4);
+		lua_pop(L, 2);
+	} else lua_pushvalue(L, arg);
+	
+	buffer_t *buf;
+	if(align||flags) {
+		if(inlined||!lua_isnil(L, -1)) luaL_argerror(L, arg, "aligned buffers can't be inline or use a pool");
+		buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+		if(!buffer_allocAlignedData(buf, size, align, flags, 0)) luaL_error(L, "failed to allocate buffer");
+		luaL_setmetatable(L, BUFFER_CLASS);
+		lua_remove(L, -2);
+	} else if(!lua_isnil(L, -1)) {
+		if(inlined) luaL_argerror(L, arg, "inline buffers can't use a pool");
+		buffer_pool_t **pool=luaL_checkudata(L, -1, POOL_CLASS);
+		buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+		if(!buffer_poolAllocData(buf, *pool, size, 0)) luaL_error(L, "failed to allocate buffer");
+		luaL_setmetatable(L, BUFFER_CLASS);
+		
+		// the pool is kept alive as long as the buffer
+		lua_insert(L, -2);
+		lua_setuservalue(L, -2);
+	} else if(inlined) {
+		if((size_t) size>BUFFER_SIZE_MAX-sizeof(buffer_t)) luaL_argerror(L, arg, "is too large for an inline buffer");
+		buf=buffer_inlineData(lua_newuserdata(L, sizeof(buffer_t)+size), size);
+		luaL_setmetatable(L, INLINE_CLASS);
+		lua_remove(L, -2);
+	} else {
+		lua_pop(L, 1);
+		buf=pushBuffer(L, size);
+	}
+	return buf;
+}
+
+/**
+ * @name ringFromArg
+ * unwraps the buffer_ring_t contained in Lua arg1
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @returns buffer_ring_t*, a pointer to the buffer_ring_t
+ */
+buffer_ring_t *ringFromArg(lua_State *L) {
+	return luaL_checkudata(L, 1, RING_CLASS);
+}
+
+/**
+ * @name spscFromArg
+ * unwraps the buffer_spsc_t referenced by Lua arg1
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @returns buffer_spsc_t*, a pointer to the buffer_spsc_t
+ */
+buffer_spsc_t *spscFromArg(lua_State *L) {
+	spscref_t *ref=luaL_checkudata(L, 1, SPSC_CLASS);
+	return ref->queue;
 }
 
 /**
@@ -270,65 +905,118 @@ int typeFromArg(lua_State *L, buffer_t *buf, int arg) {
 		int type=luaL_checkinteger(L, arg);
 		if(isValidType(type)) return type;
 	} else if(lua_isstring(L, arg)) {
-		// treat the argument as a string type and return it if it is valid
-		size_t len=0;
-		const char* str=luaL_checklstring(L, arg, &len);
-		
-		// check if the type is signed
-		int signedness=startswith(str, "signed ");
-		if(signedness) {
-			str+=7; // length of "signed "
-		} else {
-			if(startswith(str, "unsigned ")) str+=9; // length of "unsigned "
-		}
+		// treat the argument as a string type, looking it up in the cache before parsing it
+		int type=-1;
+		arg=lua_absindex(L, arg);
+		if(lua_rawgetp(L, LUA_REGISTRYINDEX, &typeCacheKey)==LUA_TTABLE) {
+			lua_pushvalue(L, arg);
+			if(lua_rawget(L, -2)==LUA_TNUMBER) type=lua_tointeger(L, -1);
+			lua_pop(L, 1);
+			
+			// only valid names are cached, so the cache can't grow unbounded
+			if(type==-1) {
+				type=parseType(lua_tostring(L, arg));
+				if(type!=-1) {
+					lua_pushvalue(L, arg);
+					lua_pushinteger(L, type);
+					lua_rawset(L, -3);
+				}
+			}
+		} else type=parseType(lua_tostring(L, arg));
+		lua_pop(L, 1);
 		
-		// get type from name
-		int type=findstr(str, (findstr_t[]) {
-			{TYPE_CHAR, "char"}
+		if(type!=-1) return type;
+	} else if(lua_isnoneornil(L, arg)&&buf!=NULL) {
+		// return the type stored in the buffer
+		return buffer_getUser(buf)&0x3f;
+	}
+	// if we're still here, there was an error that we need to throw
+	return luaL_argerror(L, arg, "must be a valid type");
+}
+
+/**
+ * @name nativeTypeFromArg
+ * reads a type like typeFromArg, but rejects types in the opposite byte order
+ * used by the kernels computing directly on the memory of the buffer
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param buf: buffer_t*, the buffer whose type is used if the argument is absent, or NULL
+ * @param arg: int, the index of the argument
+ * @returns int, the type
+ */
+int nativeTypeFromArg(lua_State *L, buffer_t *buf, int arg) {
+	int type=typeFromArg(L, buf, arg);
+	if(type&TYPE_SWAPPED) return luaL_argerror(L, arg, "must be in native byte order, use byteswap first");
+	return type;
+}
+
+/**
+ * @name parseType
+ * parses a type name, such as "unsigned int" or "int32"
+ * @param str: char*, the name of the type
+ * @returns int, the type, -1 if invalid
+ */
+int parseType(const char* str) {
+	// check if the type is signed
+	int signedness=startswith(str, "signed ");
+	if(signedness) {
+		str+=7; // length of "signed "
+	} else {
+		if(startswith(str, "unsigned ")) str+=9; // length of "unsigned "
+	}
+	
+	// check the byte order, which is only given for fixed-width and floating-point types
+	int order=-1;
+	if(startswith(str, "be")) order=TYPE_BE;
+	else if(startswith(str, "le")) order=TYPE_LE;
+	if(order!=-1) str+=2; // length of "be" and "le"
+	
+	// get type from name
+	int type=findstr(str, (findstr_t[]) {
+		{TYPE_CHAR, "char"}
 #ifdef TYPE_SHORT
-			,{TYPE_SHORT, "short"}
+		,{TYPE_SHORT, "short"}
 #endif
 #ifdef TYPE_INT
-			,{TYPE_INT, "int"}
+		,{TYPE_INT, "int"}
 #endif
 #ifdef TYPE_LONG
-			,{TYPE_LONG, "long"}
+		,{TYPE_LONG, "long"}
 #endif
 #ifdef TYPE_LONGLONG
-			,{TYPE_LONGLONG, "long long"}
+		,{TYPE_LONGLONG, "long long"}
 #endif
-			,{TYPE_FLOAT, "float"}
+		,{TYPE_FLOAT, "float"}
 #ifdef TYPE_DOUBLE
-			,{TYPE_DOUBLE, "double"}
+		,{TYPE_DOUBLE, "double"}
 #endif
-			,{TYPE_8, "8"}
-			,{TYPE_8, "int8"}
+		,{TYPE_8, "8"}
+		,{TYPE_8, "int8"}
 #ifdef TYPE_16
-			,{TYPE_16, "16"}
-			,{TYPE_16, "int16"}
+		,{TYPE_16, "16"}
+		,{TYPE_16, "int16"}
 #endif
 #ifdef TYPE_32
-			,{TYPE_32, "32"}
-			,{TYPE_32, "int32"}
+		,{TYPE_32, "32"}
+		,{TYPE_32, "int32"}
 #endif
 #ifdef TYPE_64
-			,{TYPE_64, "64"}
-			,{TYPE_64, "int64"}
+		,{TYPE_64, "64"}
+		,{TYPE_64, "int64"}
 #endif
-			,{-1, NULL}
-		});
-		
-		// return the type if it is valid
-		if(type!=-1) {
-			type|=signedness<<4;
-			if(isValidType(type)) return type;
+		,{-1, NULL}
+	});
+	
+	// return the type if it is valid
+	if(type!=-1) {
+		type|=signedness<<4;
+		if(order!=-1) {
+			if(!typeSizes[type|TYPE_SWAPPED]) return -1;
+			type|=order;
 		}
-	} else if(lua_isnoneornil(L, arg)&&buf!=NULL) {
-		// return the type stored in the buffer
-		return buffer_getUser(buf)&0x1f;
+		if(isValidType(type)) return type;
 	}
-	// if we're still here, there was an error that we need to throw
-	return luaL_argerror(L, arg, "must be a valid type");
+	return -1;
 }
 
 /**
@@ -370,9 +1058,9 @@ int findstr(const char* str, findstr_t* list) {
  * determines the length of a buffer according to its type
  * @param buf: buffer_t*, the buffer
  * @param type: int, the type
- * @returns int, the length, -1 if unable to determine it
+ * @returns lua_Integer, the length, -1 if unable to determine it
  */
-int getLength(buffer_t *buf, int type) {
+lua_Integer getLength(buffer_t *buf, int type) {
 	switch(type&0xf) {
 		lenForType(CHAR)
 #ifdef TYPE_SHORT
@@ -406,6 +1094,282 @@ int getLength(buffer_t *buf, int type) {
 }
 #undef lenForType
 
+/**
+ * @name sizeFromArg
+ * reads a size or a length from Lua arg#arg
+ * throws if it isn't positive or doesn't fit in a buffer_size_t
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @returns buffer_size_t, the size
+ */
+buffer_size_t sizeFromArg(lua_State *L, int arg) {
+	lua_Integer size=luaL_checkinteger(L, arg);
+	if(size<=0) return luaL_argerror(L, arg, "must be positive");
+	if((lua_Unsigned) size>(lua_Unsigned) BUFFER_SIZE_MAX) return luaL_argerror(L, arg, "is too large");
+	return (buffer_size_t) size;
+}
+
+/**
+ * @name rangeFromArgs
+ * reads an inclusive range of indices from Lua args #arg and #arg+1, which default to 1 and -1
+ * negative indices count from the end, like in string.sub, and the range is clamped to the buffer
+ * @param L: lua_State, the Lua instance
+ * @param len: lua_Integer, the length of the buffer
+ * @param arg: int, the index of the first argument
+ * @param first: lua_Integer*, where to store the 0-based index of the first element
+ * @returns lua_Integer, the number of elements in the range
+ */
+lua_Integer rangeFromArgs(lua_State *L, lua_Integer len, int arg, lua_Integer *first) {
+	lua_Integer i=luaL_optinteger(L, arg, 1);
+	lua_Integer j=luaL_optinteger(L, arg+1, -1);
+	if(i<0) i+=len+1;
+	if(j<0) j+=len+1;
+	if(i<1) i=1;
+	if(j>len) j=len;
+	*first=i-1;
+	return i>j?0:j-i+1;
+}
+
+/**
+ * @name integerAt
+ * reads an integer at a given stack index, for bulk writes
+ * throws on error, mentioning the position of the value
+ * @param L: lua_State, the Lua instance
+ * @param idx: int, the stack index
+ * @param pos: lua_Integer, the position of the value, for error messages
+ * @returns lua_Integer, the value
+ */
+lua_Integer integerAt(lua_State *L, int idx, lua_Integer pos) {
+	int isnum=0;
+	lua_Integer val=lua_tointegerx(L, idx, &isnum);
+	if(!isnum) return luaL_error(L, "value #%I is not an integer", pos);
+	return val;
+}
+
+/**
+ * @name numberAt
+ * reads a number at a given stack index, for bulk writes
+ * throws on error, mentioning the position of the value
+ * @param L: lua_State, the Lua instance
+ * @param idx: int, the stack index
+ * @param pos: lua_Integer, the position of the value, for error messages
+ * @returns lua_Number, the value
+ */
+lua_Number numberAt(lua_State *L, int idx, lua_Integer pos) {
+	int isnum=0;
+	lua_Number val=lua_tonumberx(L, idx, &isnum);
+	if(!isnum) return luaL_error(L, "value #%I is not a number", pos);
+	return val;
+}
+
+#define push(type, sgn, luatype) case typecode(type, sgn): \
+	lua_push##luatype(L, buffer_get(buf, idx, typename(sgn, type))); \
+	return;
+#define pushSwapped(type, sgn, luatype) case swappedcode(type, sgn): { \
+	typename(sgn, type) val; \
+	swapValue(&val, buffer_getArray(buf, typename(sgn, type))+idx, sizeof(val)); \
+	lua_push##luatype(L, val); \
+	return; \
+}
+/**
+ * @name swapValue
+ * copies a value of size bytes, reversing its bytes
+ * @param dst: void*, where to write the value
+ * @param src: const void*, where to read the value
+ * @param size: int, the size of the value, up to 8
+ */
+void swapValue(void *dst, const void *src, int size) {
+#if defined(__GNUC__)
+	// the builtins compile to single instructions
+	switch(size) {
+		case 2: {
+			uint16_t v;
+			memcpy(&v, src, 2);
+			v=__builtin_bswap16(v);
+			memcpy(dst, &v, 2);
+			return;
+		}
+		case 4: {
+			uint32_t v;
+			memcpy(&v, src, 4);
+			v=__builtin_bswap32(v);
+			memcpy(dst, &v, 4);
+			return;
+		}
+		case 8: {
+			uint64_t v;
+			memcpy(&v, src, 8);
+			v=__builtin_bswap64(v);
+			memcpy(dst, &v, 8);
+			return;
+		}
+	}
+#endif
+	unsigned char tmp[8];
+	memcpy(tmp, src, size);
+	for(int i=0; i<size; i++) ((unsigned char*) dst)[i]=tmp[size-1-i];
+}
+
+/**
+ * @name pushValue
+ * pushes the value at a given index of a buffer, without bounds checking
+ * @param L: lua_State, the Lua instance
+ * @param buf: buffer_t*, the buffer
+ * @param type: int, the type, which must be valid
+ * @param idx: lua_Integer, the 0-based index
+ */
+void pushValue(lua_State *L, buffer_t *buf, int type, lua_Integer idx) {
+	switch(type) {
+		forEachType(push)
+		forEachSwappedType(pushSwapped)
+	}
+	lua_pushnil(L);
+}
+#undef push
+#undef pushSwapped
+
+/**
+ * @name wrapInteger
+ * converts a number to the bits of an integer, rounding towards zero and wrapping around instead of overflowing
+ * unlike a cast, this is defined for every number, and keeps the values of unsigned 64 bit integers above LUA_MAXINTEGER
+ * @param val: lua_Number, the number
+ * @returns lua_Unsigned, the bits of the integer
+ */
+lua_Unsigned wrapInteger(lua_Number val) {
+	if(val!=val) return 0;
+	if(val<0) return -wrapInteger(-val);
+	// the range of lua_Unsigned, which is exact as a float
+	lua_Number range=-2*(lua_Number) LUA_MININTEGER;
+	if(val>=range) val=fmod(val, range);
+	return (lua_Unsigned) val;
+}
+
+#define store(type, sgn, luatype) case typecode(type, sgn): \
+	buffer_set(buf, idx, (typename(U, type)) luaL_check##luatype(L, arg), typename(U, type)); \
+	return;
+#define storeSwapped(type, sgn, luatype) case swappedcode(type, sgn): { \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, arg); \
+	swapValue(buffer_getArray(buf, typename(U, type))+idx, &val, sizeof(val)); \
+	return; \
+}
+/**
+ * @name storeValue
+ * writes the value of Lua arg#arg at a given index of a buffer, without bounds checking
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param buf: buffer_t*, the buffer
+ * @param type: int, the type, which must be valid
+ * @param idx: lua_Integer, the 0-based index
+ * @param arg: int, the index of the argument
+ */
+void storeValue(lua_State *L, buffer_t *buf, int type, lua_Integer idx, int arg) {
+	switch(type) {
+		forEachType(store)
+		forEachSwappedType(storeSwapped)
+	}
+	luaL_error(L, "unable to set value");
+}
+#undef store
+#undef storeSwapped
+
+#define store(type, sgn, luatype) case typecode(type, sgn): \
+	for(k=0; k<n; k++) { \
+		if(fromTable) lua_rawgeti(L, src, k+1); \
+		buffer_set(buf, first+k, (typename(U, type)) luatype##At(L, fromTable?-1:src+k, k+1), typename(U, type)); \
+		if(fromTable) lua_pop(L, 1); \
+	} \
+	return n;
+#define storeSwapped(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(k=0; k<n; k++) { \
+		if(fromTable) lua_rawgeti(L, src, k+1); \
+		typename(U, type) val=(typename(U, type)) luatype##At(L, fromTable?-1:src+k, k+1); \
+		swapValue(buffer_getArray(buf, typename(U, type))+first+k, &val, sizeof(val)); \
+		if(fromTable) lua_pop(L, 1); \
+	} \
+	return n;
+/**
+ * @name storeValues
+ * writes n consecutive values into a buffer, dispatching on the type only once
+ * the values are read either from a table or from consecutive stack slots
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param buf: buffer_t*, the buffer
+ * @param type: int, the type
+ * @param first: lua_Integer, the 0-based index of the first element to write
+ * @param n: lua_Integer, the number of values to write, which must fit in the buffer
+ * @param src: int, the stack index of the table or of the first value
+ * @param fromTable: int, nonzero if src is a table
+ * @returns lua_Integer, the number of values written
+ */
+lua_Integer storeValues(lua_State *L, buffer_t *buf, int type, lua_Integer first, lua_Integer n, int src, int fromTable) {
+	lua_Integer k;
+	switch(type) {
+		forEachType(store)
+		forEachSwappedType(storeSwapped)
+	}
+	return luaL_error(L, "unable to set value");
+}
+#undef store
+#undef storeSwapped
+
+#define pushAt(type, sgn, luatype) case typecode(type, sgn): { \
+	typename(sgn, type) val; \
+	memcpy(&val, ptr, sizeof(val)); \
+	lua_push##luatype(L, val); \
+	return; \
+}
+#define pushSwappedAt(type, sgn, luatype) case swappedcode(type, sgn): { \
+	typename(sgn, type) val; \
+	swapValue(&val, ptr, sizeof(val)); \
+	lua_push##luatype(L, val); \
+	return; \
+}
+/**
+ * @name pushValueAt
+ * pushes the value stored at a pointer, which doesn't need to be aligned
+ * @param L: lua_State, the Lua instance
+ * @param ptr: const char*, the pointer to the value
+ * @param type: int, the type, which must be valid
+ */
+void pushValueAt(lua_State *L, const char *ptr, int type) {
+	switch(type) {
+		forEachType(pushAt)
+		forEachSwappedType(pushSwappedAt)
+	}
+	lua_pushnil(L);
+}
+#undef pushAt
+#undef pushSwappedAt
+
+#define storeAt(type, sgn, luatype) case typecode(type, sgn): { \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, arg); \
+	memcpy(ptr, &val, sizeof(val)); \
+	return; \
+}
+#define storeSwappedAt(type, sgn, luatype) case swappedcode(type, sgn): { \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, arg); \
+	swapValue(ptr, &val, sizeof(val)); \
+	return; \
+}
+/**
+ * @name storeValueAt
+ * writes the value of Lua arg#arg at a pointer, which doesn't need to be aligned
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param ptr: char*, the pointer to the value
+ * @param type: int, the type, which must be valid
+ * @param arg: int, the index of the argument
+ */
+void storeValueAt(lua_State *L, char *ptr, int type, int arg) {
+	switch(type) {
+		forEachType(storeAt)
+		forEachSwappedType(storeSwappedAt)
+	}
+	luaL_error(L, "unable to set value");
+}
+#undef storeAt
+#undef storeSwappedAt
+
 #define sizeForType(type) case TYPE_##type: \
 	return sizeof(typename(U, type));
 /**
@@ -447,52 +1411,108 @@ int typeSize(int type) {
 	return -1;
 }
 #undef sizeForType
+
+/**
+ * @name fileFromArg
+ * reads a file from Lua arg#arg, either a file handle from the io library or a file descriptor
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @param fd: int*, where to store the file descriptor
+ * @returns FILE*, the file handle, NULL if the argument is a file descriptor
+ */
+FILE *fileFromArg(lua_State *L, int arg, int *fd) {
+	luaL_Stream *stream=luaL_testudata(L, arg, LUA_FILEHANDLE);
+	if(stream!=NULL) {
+		if(stream->closef==NULL) luaL_argerror(L, arg, "attempt to use a closed file");
+		*fd=fileno(stream->f);
+		return stream->f;
+	}
+	lua_Integer desc=luaL_checkinteger(L, arg);
+	if(desc<0||desc>INT_MAX) luaL_argerror(L, arg, "must be a file or a file descriptor");
+	*fd=desc;
+	return NULL;
+}
+
+/**
+ * @name syncFile
+ * moves the file descriptor of a stdio stream to the position of the stream, before using the descriptor directly
+ * output streams are flushed, and input streams drop their buffer by seeking to their position, as fflush is undefined on them
+ * @param file: FILE*, the stream
+ */
+void syncFile(FILE *file) {
+#ifdef __linux__
+	if(!__freading(file)) {
+		fflush(file);
+		return;
+	}
+#endif
+	// this also writes pending output, for the platforms which can't tell both kinds of streams apart
+	fseek(file, 0, SEEK_CUR);
+}
+
+/**
+ * @name runKernel
+ * runs the task of a numeric kernel over n elements, split between threads when there are enough of them
+ * @param task: buffer_task_t, the task of the kernel for the type of the elements
+ * @param kernel: kernel_t*, the arguments of the kernel, which also receives the result of each chunk
+ * @param n: lua_Integer, the number of elements
+ * @param type: int, the type of the elements
+ * @returns int, the number of chunks
+ */
+int runKernel(buffer_task_t task, kernel_t *kernel, lua_Integer n, int type) {
+	return buffer_parallel((buffer_size_t) n, BUFFER_PARALLEL_GRAIN/typeSize(type), task, kernel);
+}
 //END internal functions
 
 //BEGIN buffer creator
 /**
- * @ref buffer.new(size)
+ * @ref buffer.new(size, [options])
+ * options is either a pool or a table with the optional fields pool and inline
+ * if a pool is given, small buffers are allocated from it, and keep it alive
+ * if inline is true, the data is stored in the buffer object itself, which then needs no finalizer
  * @arg1: int, size
+ * @arg2: pool|table?, options
  * @rer1: buffer, buf
  */
 int api_bufferNew(lua_State *L) {
-	int size=luaL_checkinteger(L, 1);
-	if(size<=0) return luaL_argerror(L, 1, "size must be positive");
-	
-	buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
-	if(!buffer_allocData(buf, size, 0)) {
-		buf->alloc=0;
-		return luaL_error(L, "failed to allocate buffer");
-	}
-	luaL_setmetatable(L, BUFFER_CLASS);
+	buffer_size_t size=sizeFromArg(L, 1);
+	newBuffer(L, size, 2);
 	return 1;
 }
 
 /**
- * @ref buffer.calloc(len, elem)
+ * @ref buffer.calloc(len, elem, [options])
+ * options are the same as for buffer.new
  * @arg1: int, len
  * @arg2: int|string, elem
+ * @arg3: pool|table?, options
  * @rer1: buffer, buf
  */
 int api_bufferCalloc(lua_State *L) {
 	// get size and/or type
-	int len=luaL_checkinteger(L, 1);
-	if(len<=0) return luaL_argerror(L, 1, "length must be positive");
-	int elem, type=TYPE_UNSIGNED|TYPE_CHAR;
-	if(lua_isnumber(L, 2)) elem=luaL_checkinteger(L, 2);
+	buffer_size_t len=sizeFromArg(L, 1);
+	buffer_size_t elem;
+	int type=TYPE_UNSIGNED|TYPE_CHAR;
+	if(lua_isnumber(L, 2)) elem=sizeFromArg(L, 2);
 	else {
 		type=typeFromArg(L, NULL, 2);
 		elem=typeSize(type);
 	}
-	if(elem<=0) return luaL_argerror(L, 2, "element size must be positive");
 	
 	// allocate and create
-	buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
-	if(!buffer_callocData(buf, len, elem, 0)) {
-		buf->alloc=0;
-		return luaL_error(L, "failed to allocate buffer");
+	if(lua_isnoneornil(L, 3)) {
+		buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+		if(!buffer_callocData(buf, len, elem, 0)) {
+			buf->alloc=0;
+			return luaL_error(L, "failed to allocate buffer");
+		}
+		luaL_setmetatable(L, BUFFER_CLASS);
+	} else {
+		if(elem&&len>BUFFER_SIZE_MAX/elem) return luaL_argerror(L, 1, "is too large");
+		buffer_t* buf=newBuffer(L, len*elem, 3);
+		memset(buffer_getPointer(buf), 0, len*elem);
 	}
-	luaL_setmetatable(L, BUFFER_CLASS);
 	
 	// set type
 	lua_pushinteger(L, type);
@@ -505,8 +1525,508 @@ int api_bufferCalloc(lua_State *L) {
 	return 1;
 }
 
+/**
+ * @ref buffer.pool()
+ * creates a pool, which allocates small buffers from size-class freelists instead of the general allocator
+ * the pool is released once it and all the buffers allocated from it are collected
+ * @ret1: pool, pool
+ */
+int api_bufferPool(lua_State *L) {
+	buffer_pool_t **pool=(buffer_pool_t**) lua_newuserdata(L, sizeof(buffer_pool_t*));
+	*pool=buffer_poolCreate();
+	if(*pool==NULL) return luaL_error(L, "failed to allocate pool");
+	luaL_setmetatable(L, POOL_CLASS);
+	return 1;
+}
+
+/**
+ * @name __gc
+ * buffers keep their pool alive, so they have all been collected
+ * @arg1: pool, pool
+ */
+int meta_poolGc(lua_State *L) {
+	buffer_pool_t **pool=luaL_checkudata(L, 1, POOL_CLASS);
+	buffer_poolDestroy(*pool);
+	*pool=NULL;
+	return 0;
+}
 //END buffer creator
 
+//BEGIN memory-mapped files
+/**
+ * @ref buffer.mmap(path, [mode], [type], [size])
+ * maps a file in memory as a buffer
+ * mode is "r" for reading (default), "w" for shared read-write, or "p" for private read-write
+ * "r" maps the file privately like "p", so that writing to the buffer from Lua copies the page instead of crashing
+ * size defaults to the size of the file, and can only be larger than it in "w" mode, which grows the file
+ * @arg1: string, path
+ * @arg2: string?, mode
+ * @arg3: string|int?, type
+ * @arg4: int?, size
+ * @ret1: buffer?, buf
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_bufferMmap(lua_State *L) {
+	static const char* const modes[]={"r", "w", "p", NULL};
+	static const int modeValues[]={BUFFER_MAP_PRIVATE, BUFFER_MAP_WRITE, BUFFER_MAP_PRIVATE};
+	const char* path=luaL_checkstring(L, 1);
+	int mode=modeValues[luaL_checkoption(L, 2, "r", modes)];
+	int type=lua_isnoneornil(L, 3)?TYPE_UNSIGNED|TYPE_CHAR:typeFromArg(L, NULL, 3);
+	buffer_size_t size=lua_isnoneornil(L, 4)?0:sizeFromArg(L, 4);
+	
+	buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+	if(!buffer_mapFileData(buf, path, mode, size, 0)) return luaL_fileresult(L, 0, path);
+	buffer_setUser(buf, type);
+	luaL_setmetatable(L, BUFFER_CLASS);
+	return 1;
+}
+
+/**
+ * @ref buf:sync()
+ * @ref buffer.sync(buf)
+ * writes the changes to a buffer mapped in "w" mode back to its file, and waits for completion
+ * does nothing on other buffers
+ * @arg1: buffer, buf
+ * @ret1: boolean?, ok
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_bufferSync(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	return luaL_fileresult(L, buffer_sync(buf), NULL);
+}
+//END memory-mapped files
+
+//BEGIN file I/O
+/**
+ * @ref buffer.readfile(path, [type])
+ * creates a buffer holding a copy of the contents of a file, read in large chunks without going through Lua strings
+ * @arg1: string, path
+ * @arg2: string|int?, type
+ * @ret1: buffer?, buf
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_bufferReadFile(lua_State *L) {
+	const char* path=luaL_checkstring(L, 1);
+	int type=lua_isnoneornil(L, 2)?TYPE_UNSIGNED|TYPE_CHAR:typeFromArg(L, NULL, 2);
+	
+	buffer_t* buf=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+	if(!buffer_readFileData(buf, path, 0)) return luaL_fileresult(L, 0, path);
+	buffer_setUser(buf, type);
+	luaL_setmetatable(L, BUFFER_CLASS);
+	return 1;
+}
+
+/**
+ * @ref buf:readfrom(file, [offset], [len], [idx])
+ * @ref buffer.readfrom(buf, file, [offset], [len], [idx])
+ * reads up to len bytes from a file into the buffer, starting at byte idx, stopping at the end of the buffer
+ * file is either a file from the io library or a file descriptor
+ * if offset is given, the bytes are read from this offset in the file, without moving its position
+ * len defaults to the rest of the buffer
+ * @arg1: buffer, buf
+ * @arg2: file|int, file
+ * @arg3: int?, offset
+ * @arg4: int?, len
+ * @arg5: int?, idx
+ * @ret1: int?, count
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_bufferReadFrom(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int fd;
+	FILE *file=fileFromArg(L, 2, &fd);
+	lua_Integer offset=luaL_optinteger(L, 3, -1);
+	if(!lua_isnoneornil(L, 3)&&offset<0) return luaL_argerror(L, 3, "must not be negative");
+	lua_Integer size=buffer_getSize(buf);
+	lua_Integer idx=luaL_optinteger(L, 5, 1);
+	if(idx<0) idx+=size+1;
+	idx--;
+	if(idx<0||idx>size) idx=size;
+	lua_Integer n=luaL_optinteger(L, 4, size-idx);
+	if(n<0) n=0;
+	if(n>size-idx) n=size-idx;
+	
+	buffer_size_t count;
+	if(file!=NULL&&offset<0) {
+		// read through the stdio buffer, which may already hold the next bytes
+		count=fread(buffer_getCharArray(buf)+idx, 1, n, file);
+		if(count<(buffer_size_t) n&&ferror(file)) return luaL_fileresult(L, 0, NULL);
+	} else {
+		// bytes that are still in the stdio buffer must reach the file first, and bytes read ahead must be given back
+		if(file!=NULL) syncFile(file);
+		count=buffer_readFrom(buf, idx, n, fd, offset);
+		if(count==BUFFER_NPOS) return luaL_fileresult(L, 0, NULL);
+	}
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+/**
+ * @ref buf:writeto(file, [i], [len], [offset])
+ * @ref buffer.writeto(buf, file, [i], [len], [offset])
+ * writes len bytes of the buffer to a file, starting at byte i, stopping at the end of the buffer
+ * file is either a file from the io library or a file descriptor
+ * if offset is given, the bytes are written at this offset in the file, without moving its position
+ * len defaults to the rest of the buffer
+ * @arg1: buffer, buf
+ * @arg2: file|int, file
+ * @arg3: int?, i
+ * @arg4: int?, len
+ * @arg5: int?, offset
+ * @ret1: int?, count
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_bufferWriteTo(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int fd;
+	FILE *file=fileFromArg(L, 2, &fd);
+	lua_Integer size=buffer_getSize(buf);
+	lua_Integer idx=luaL_optinteger(L, 3, 1);
+	if(idx<0) idx+=size+1;
+	idx--;
+	if(idx<0||idx>size) idx=size;
+	lua_Integer n=luaL_optinteger(L, 4, size-idx);
+	if(n<0) n=0;
+	if(n>size-idx) n=size-idx;
+	lua_Integer offset=luaL_optinteger(L, 5, -1);
+	if(!lua_isnoneornil(L, 5)&&offset<0) return luaL_argerror(L, 5, "must not be negative");
+	
+	buffer_size_t count;
+	if(file!=NULL&&offset<0) {
+		count=fwrite(buffer_getCharArray(buf)+idx, 1, n, file);
+		if(count<(buffer_size_t) n) return luaL_fileresult(L, 0, NULL);
+	} else {
+		// keep the order of the bytes written through the stdio buffer
+		if(file!=NULL) syncFile(file);
+		count=buffer_writeTo(buf, idx, n, fd, offset);
+		if(count==BUFFER_NPOS) return luaL_fileresult(L, 0, NULL);
+	}
+	lua_pushinteger(L, count);
+	return 1;
+}
+//END file I/O
+
+//BEGIN copy
+/**
+ * @ref buf:clone([i], [j])
+ * @ref buffer.clone(buf, [i], [j])
+ * creates a buffer holding a copy of elements i to j, with the same type
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @ret1: buffer, clone
+ */
+int api_bufferClone(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=buffer_getUser(buf)&0x3f;
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	if(n<=0) return luaL_argerror(L, 2, "cannot create an empty buffer");
+	
+	buffer_t *clone=pushBuffer(L, n*typeSize(type));
+	buffer_copy(clone, 0, buf, first*typeSize(type), n*typeSize(type));
+	buffer_setUser(clone, buffer_getUser(buf));
+	return 1;
+}
+
+/**
+ * @ref src:copy(dst, [i], [j], [idx])
+ * @ref buffer.copy(src, dst, [i], [j], [idx])
+ * copies elements i to j of src to dst, starting at element idx
+ * each buffer's indices are in units of its own type, and the copy stops at the end of dst
+ * @arg1: buffer, src
+ * @arg2: buffer, dst
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: int?, idx
+ * @ret1: int, count
+ */
+int api_bufferCopy(lua_State *L) {
+	buffer_t *src=bufferFromArg(L);
+	buffer_t *dst=bufferAt(L, 2);
+	int ssize=typeSize(buffer_getUser(src)&0x3f);
+	int dsize=typeSize(buffer_getUser(dst)&0x3f);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(src, buffer_getUser(src)), 3, &first);
+	lua_Integer dlen=getLength(dst, buffer_getUser(dst));
+	lua_Integer idx=luaL_optinteger(L, 5, 1);
+	if(idx<0) idx+=dlen+1;
+	idx--;
+	
+	// only copy whole elements that fit in dst
+	lua_Integer room=idx<0||idx>=dlen?0:(lua_Integer) (buffer_getSize(dst)-idx*dsize)/ssize;
+	if(n>room) n=room;
+	
+	buffer_copy(dst, idx*dsize, src, first*ssize, n*ssize);
+	lua_pushinteger(L, n);
+	return 1;
+}
+
+/**
+ * @ref buf:internalcopy(i, len, idx)
+ * @ref buffer.internalcopy(buf, i, len, idx)
+ * copies len elements starting at element i to element idx, handling overlapping ranges
+ * the copy is clamped to the buffer
+ * @arg1: buffer, buf
+ * @arg2: int, i
+ * @arg3: int, len
+ * @arg4: int, idx
+ * @ret1: int, count
+ */
+int api_bufferInternalCopy(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int size=typeSize(buffer_getUser(buf)&0x3f);
+	lua_Integer len=getLength(buf, buffer_getUser(buf));
+	lua_Integer from=luaL_checkinteger(L, 2);
+	lua_Integer n=luaL_checkinteger(L, 3);
+	lua_Integer to=luaL_checkinteger(L, 4);
+	if(from<0) from+=len+1;
+	if(to<0) to+=len+1;
+	from--;
+	to--;
+	
+	if(n<0||from<0||to<0||from>=len||to>=len) n=0;
+	if(n>len-from) n=len-from;
+	if(n>len-to) n=len-to;
+	
+	buffer_move(buf, to*size, from*size, n*size);
+	lua_pushinteger(L, n);
+	return 1;
+}
+//END copy
+
+//BEGIN views
+/**
+ * @ref buf:view([i], [len], [type])
+ * @ref buffer.view(buf, [i], [len], [type])
+ * creates a buffer aliasing len elements of buf starting at element i, without copying them
+ * len defaults to the rest of the buffer, and type to the type of buf
+ * the view keeps buf alive and can't be resized, and while it exists buf can't move its memory
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, len
+ * @arg4: string|int?, type
+ * @ret1: buffer, view
+ */
+int api_bufferView(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int size=typeSize(buffer_getUser(buf)&0x3f);
+	lua_Integer len=getLength(buf, buffer_getUser(buf));
+	lua_Integer first=luaL_optinteger(L, 2, 1);
+	if(first<0) first+=len+1;
+	first--;
+	if(first<0||first>=len) return luaL_argerror(L, 2, "out of bounds");
+	lua_Integer n=luaL_optinteger(L, 3, len-first);
+	if(n<=0) return luaL_argerror(L, 3, "cannot create an empty view");
+	if(n>len-first) return luaL_argerror(L, 3, "out of bounds");
+	int type=typeFromArg(L, buf, 4);
+	
+	buffer_t *view=(buffer_t*) lua_newuserdata(L, sizeof(buffer_t));
+	if(!buffer_viewData(view, buf, first*size, n*size, 0)) return luaL_error(L, "buffer has too many views");
+	buffer_setUser(view, (buffer_getUser(buf)&~0x3f)|type);
+	luaL_setmetatable(L, BUFFER_CLASS);
+	
+	// the parent is unpinned when the view is collected
+	lua_pushvalue(L, 1);
+	lua_setuservalue(L, -2);
+	return 1;
+}
+//END views
+
+//BEGIN search
+#define encode(type, sgn, luatype) case typecode(type, sgn): { \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, arg); \
+	memcpy(value, &val, sizeof(val)); \
+	*len=sizeof(val); \
+	return 1; \
+}
+#define encodeSwapped(type, sgn, luatype) case swappedcode(type, sgn): { \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, arg); \
+	swapValue(value, &val, sizeof(val)); \
+	*len=sizeof(val); \
+	return 1; \
+}
+/**
+ * @name needleFromArg
+ * reads what to search for from Lua arg#arg
+ * strings and buffers are searched as bytes, numbers as a value of the given type
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @param type: int, the type of the values
+ * @param needle: const char**, where to store the pointer to the bytes to search
+ * @param len: size_t*, where to store the number of bytes to search
+ * @param value: char*, storage for the encoded value, at least 16 bytes long
+ * @returns int, nonzero for a typed search, zero for a byte search
+ */
+int needleFromArg(lua_State *L, int arg, int type, const char **needle, size_t *len, char *value) {
+	if(lua_type(L, arg)==LUA_TNUMBER) {
+		*needle=value;
+		switch(type) {
+			forEachType(encode)
+			forEachSwappedType(encodeSwapped)
+		}
+		return luaL_argerror(L, arg, "unable to encode value");
+	}
+	buffer_t *sub=testBuffer(L, arg);
+	if(sub!=NULL) {
+		*needle=buffer_getPointer(sub);
+		*len=buffer_getSize(sub);
+		return 0;
+	}
+	*needle=luaL_checklstring(L, arg, len);
+	return 0;
+}
+#undef encode
+#undef encodeSwapped
+
+/**
+ * @ref buf:find(sub, [start], [type])
+ * @ref buffer.find(buf, sub, [start], [type])
+ * finds the first occurrence of sub, starting at index start
+ * if sub is a string or a buffer, its bytes are searched and start and the result are byte indices
+ * if sub is a number, an element of the given type equal to it is searched and start and the result are element indices
+ * @arg1: buffer, buf
+ * @arg2: string|buffer|number, sub
+ * @arg3: int?, start
+ * @arg4: string|int?, type
+ * @ret1: int?, idx
+ */
+int api_bufferFind(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 4);
+	const char* needle;
+	size_t len;
+	char value[16];
+	int typed=needleFromArg(L, 2, type, &needle, &len, value);
+	lua_Integer count=typed?getLength(buf, type):(lua_Integer) buffer_getSize(buf);
+	lua_Integer start=luaL_optinteger(L, 3, 1);
+	if(start<0) start+=count+1;
+	if(start<1) start=1;
+	if(start>count+1) return 0;
+	
+	buffer_size_t found=typed?buffer_findValue(buf, start-1, needle, len):buffer_find(buf, start-1, needle, len);
+	if(found==BUFFER_NPOS) return 0;
+	lua_pushinteger(L, (lua_Integer) found+1);
+	return 1;
+}
+
+/**
+ * @ref buf:findall(sub, [start], [type])
+ * @ref buffer.findall(buf, sub, [start], [type])
+ * finds all the non-overlapping occurrences of sub, starting at index start, following the same rules as find
+ * the indices are returned as a buffer of signed 64-bit integers (32-bit if unavailable)
+ * @arg1: buffer, buf
+ * @arg2: string|buffer|number, sub
+ * @arg3: int?, start
+ * @arg4: string|int?, type
+ * @ret1: buffer?, indices
+ */
+int api_bufferFindAll(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 4);
+	const char* needle;
+	size_t len;
+	char value[16];
+	int typed=needleFromArg(L, 2, type, &needle, &len, value);
+	lua_Integer count=typed?getLength(buf, type):(lua_Integer) buffer_getSize(buf);
+	lua_Integer start=luaL_optinteger(L, 3, 1);
+	if(start<0) start+=count+1;
+	if(start<1) start=1;
+	if(start>count+1) return 0;
+	
+	buffer_t *indices=NULL;
+	buffer_size_t n=0;
+	buffer_size_t found=start-1;
+	while((found=typed?buffer_findValue(buf, found, needle, len):buffer_find(buf, found, needle, len))!=BUFFER_NPOS) {
+		// buffer_resize grows the allocation geometrically, so this stays linear
+		if(indices==NULL) indices=pushBuffer(L, sizeof(T_INDEX));
+		else if(!buffer_resize(indices, (n+1)*sizeof(T_INDEX))) return luaL_error(L, "error while resizing buffer");
+		buffer_set(indices, n++, (T_INDEX) found+1, T_INDEX);
+		
+		found+=typed||len==0?1:len;
+	}
+	
+	if(indices==NULL) return 0;
+	buffer_setUser(indices, TYPE_INDEX);
+	return 1;
+}
+//END search
+
+//BEGIN string conversion
+/**
+ * @ref buf:readstring([i], [j])
+ * @ref buffer.readstring(buf, [i], [j])
+ * reads bytes i to j of the buffer as a string
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @ret1: string, str
+ */
+int api_bufferReadString(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, buffer_getSize(buf), 2, &first);
+	lua_pushlstring(L, buffer_getCharArray(buf)+first, n);
+	return 1;
+}
+
+/**
+ * @ref buf:writestring(str, [i], [j], [idx])
+ * @ref buffer.writestring(buf, str, [i], [j], [idx])
+ * writes bytes i to j of the string into the buffer, starting at byte idx, stopping at the end of the buffer
+ * @arg1: buffer, buf
+ * @arg2: string, str
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: int?, idx
+ * @ret1: int, count
+ */
+int api_bufferWriteString(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	size_t len;
+	const char* str=luaL_checklstring(L, 2, &len);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, len, 3, &first);
+	lua_Integer size=buffer_getSize(buf);
+	lua_Integer idx=luaL_optinteger(L, 5, 1);
+	if(idx<0) idx+=size+1;
+	idx--;
+	
+	if(idx<0||idx>=size) n=0;
+	else if(n>size-idx) n=size-idx;
+	
+	memcpy(buffer_getCharArray(buf)+idx, str+first, n);
+	lua_pushinteger(L, n);
+	return 1;
+}
+
+/**
+ * @ref buffer.fromstring(str, [i], [j])
+ * creates a buffer in char mode holding bytes i to j of the string
+ * @arg1: string, str
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @ret1: buffer, buf
+ */
+int api_bufferFromString(lua_State *L) {
+	size_t len;
+	const char* str=luaL_checklstring(L, 1, &len);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, len, 2, &first);
+	if(n<=0) return luaL_argerror(L, 1, "cannot create an empty buffer");
+	
+	buffer_t *buf=pushBuffer(L, n);
+	memcpy(buffer_getPointer(buf), str+first, n);
+	return 1;
+}
+//END string conversion
+
 //BEGIN size getter/setter
 /**
  * @ref buf.size
@@ -530,13 +2050,123 @@ int api_bufferGetSize(lua_State *L) {
  */
 int api_bufferSetSize(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
-	int size=luaL_checkinteger(L, 2);
-	if(size<=0) return luaL_argerror(L, 2, "the size must be positive");
+	buffer_size_t size=sizeFromArg(L, 2);
 	if(!buffer_resize(buf, size)) return luaL_error(L, "error while resizing buffer");
+	checkInline(L, 1, buf);
 	return 0;
 }
 //END size getter/setter
 
+//BEGIN capacity management
+/**
+ * @ref buf.capacity
+ * @ref buf:getcapacity()
+ * @ref buffer.getcapacity(buf)
+ * @arg1: buffer, buf
+ * @ret1: int, capacity
+ */
+int api_bufferGetCapacity(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_pushinteger(L, buffer_getAllocatedSize(buf));
+	return 1;
+}
+
+/**
+ * @ref buf:reserve(size)
+ * @ref buffer.reserve(buf, size)
+ * @arg1: buffer, buf
+ * @arg2: int, size
+ */
+int api_bufferReserve(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	buffer_size_t size=sizeFromArg(L, 2);
+	if(!buffer_reserve(buf, size)) return luaL_error(L, "error while reserving memory");
+	checkInline(L, 1, buf);
+	return 0;
+}
+
+/**
+ * @ref buf:shrink()
+ * @ref buffer.shrink(buf)
+ * views and wrapped buffers don't own their memory, so nothing happens
+ * @arg1: buffer, buf
+ */
+int api_bufferShrink(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	if(!buffer_shrinkToFit(buf)) return luaL_error(L, "error while shrinking buffer");
+	return 0;
+}
+
+/**
+ * @ref buffer.getgrowth()
+ * @ret1: number, factor
+ */
+int api_bufferGetGrowth(lua_State *L) {
+	lua_pushnumber(L, buffer_getGrowthFactor());
+	return 1;
+}
+
+/**
+ * @ref buffer.setgrowth(factor)
+ * @arg1: number, factor
+ */
+int api_bufferSetGrowth(lua_State *L) {
+	lua_Number factor=luaL_checknumber(L, 1);
+	if(!isfinite(factor)) return luaL_argerror(L, 1, "must be finite");
+	buffer_setGrowthFactor(factor);
+	return 0;
+}
+//END capacity management
+
+//BEGIN threads
+/**
+ * @ref buffer.getthreads()
+ * @ret1: int, threads
+ */
+int api_bufferGetThreads(lua_State *L) {
+	lua_pushinteger(L, buffer_getThreads());
+	return 1;
+}
+
+/**
+ * @ref buffer.setthreads(threads)
+ * sets the number of threads, counting the calling one, splitting the numeric kernels, conversions and copies of large ranges
+ * the threads are shared by the whole process, and stopped when the last state which set them is closed
+ * @arg1: int, threads
+ * @ret1: int, the number of threads actually available
+ */
+int api_bufferSetThreads(lua_State *L) {
+	lua_Integer threads=luaL_checkinteger(L, 1);
+	if(threads>BUFFER_MAX_THREADS) threads=BUFFER_MAX_THREADS;
+	
+	// the threads run the code of this library, which is unloaded along with the state
+	// the registry holds the number of threads this state last set, for its finalizer
+	int *set;
+	if(lua_rawgetp(L, LUA_REGISTRYINDEX, &threadsKey)==LUA_TNIL) {
+		set=lua_newuserdata(L, sizeof(int));
+		lua_newtable(L);
+		lua_pushcfunction(L, meta_threadsGc);
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &threadsKey);
+	} else set=lua_touserdata(L, -1);
+	
+	*set=buffer_setThreads((int) threads);
+	lua_pushinteger(L, *set);
+	return 1;
+}
+
+/**
+ * @ref threads:__gc()
+ * stops the threads before the library is unloaded, unless another state or the host changed their number since this state last did
+ */
+int meta_threadsGc(lua_State *L) {
+	int *set=lua_touserdata(L, 1);
+	if(buffer_getThreads()==*set) buffer_setThreads(1);
+	return 0;
+}
+//END threads
+
 //BEGIN length getter/setter
 /**
  * @ref #buf
@@ -550,7 +2180,7 @@ int api_bufferSetSize(lua_State *L) {
 int api_bufferGetLength(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
 	int type=typeFromArg(L, buf, 2);
-	int len=getLength(buf, type);
+	lua_Integer len=getLength(buf, type);
 	if(len==-1) return luaL_error(L, "unable to get length");
 	lua_pushinteger(L, len);
 	return 1;
@@ -566,12 +2196,13 @@ int api_bufferGetLength(lua_State *L) {
  */
 int api_bufferSetLength(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
-	int len=luaL_checkinteger(L, 2);
+	buffer_size_t len=sizeFromArg(L, 2);
 	int type=typeFromArg(L, buf, 3);
 	int size=typeSize(type);
 	if(size==-1) return luaL_error(L, "unable to get size of type for resizing");
-	if(len<=0) return luaL_argerror(L, 2, "the length must be positive");
+	if(len>BUFFER_SIZE_MAX/size) return luaL_argerror(L, 2, "is too large");
 	if(!buffer_resize(buf, size*len)) return luaL_error(L, "error while resizing buffer");
+	checkInline(L, 1, buf);
 	return 0;
 }
 //END length getter/setter
@@ -586,7 +2217,7 @@ int api_bufferSetLength(lua_State *L) {
  */
 int api_bufferGetType(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
-	lua_pushinteger(L, buffer_getUser(buf)&0x1f);
+	lua_pushinteger(L, buffer_getUser(buf)&0x3f);
 	return 1;
 }
 
@@ -600,7 +2231,7 @@ int api_bufferGetType(lua_State *L) {
 int api_bufferSetType(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
 	int type=typeFromArg(L, buf, 2);
-	int user=buffer_getUser(buf)&~0x1f;
+	int user=buffer_getUser(buf)&~0x3f;
 	buffer_setUser(buf, user|type);
 	return 0;
 }
@@ -622,10 +2253,14 @@ int api_bufferSetType(lua_State *L) {
  */
 int api_bufferGet(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
-	int idx=luaL_checkinteger(L, 2)-1;
+	lua_Integer idx=luaL_checkinteger(L, 2)-1;
 	int type=typeFromArg(L, buf, 3);
 	
 	if(idx<0||idx>=getLength(buf, type)) return 0;
+	if(type&TYPE_SWAPPED) {
+		pushValue(L, buf, type, idx);
+		return 1;
+	}
 	
 	int ok=0;
 	if(type&TYPE_SIGNED) {
@@ -709,10 +2344,14 @@ int api_bufferGet(lua_State *L) {
  */
 int api_bufferSet(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
-	int idx=luaL_checkinteger(L, 2)-1;
+	lua_Integer idx=luaL_checkinteger(L, 2)-1;
 	int type=typeFromArg(L, buf, 4);
 	
 	if(idx<0||idx>=getLength(buf, type)) return 0;
+	if(type&TYPE_SWAPPED) {
+		storeValue(L, buf, type, idx, 3);
+		return 0;
+	}
 	
 	int ok=0;
 	switch(type&0xf) {
@@ -749,46 +2388,2382 @@ int api_bufferSet(lua_State *L) {
 	else return 0;
 }
 #undef set
-//END value getter/setter
 
-//BEGIN metamethods
 /**
- * @name __index
- * @ref buf[key]
+ * @ref buf:getat(offset, [type])
+ * @ref buffer.getat(buf, offset, [type])
+ * reads a value at a byte offset, starting from 0, whatever the alignment
+ * returns nothing if the value doesn't fit in the buffer
  * @arg1: buffer, buf
- * @arg2: any, key
- * @ret: any
+ * @arg2: int, offset
+ * @arg3: string|int?, type
+ * @ret1: number, value
  */
-int meta_index(lua_State *L) {
-	if(lua_isnumber(L, 2)) return api_bufferGet(L);
-	else {
-		// try getting from the first upvalue (the getter list)
-		lua_settop(L, 3);
-		lua_copy(L, 2, 3);
-		if(lua_gettable(L, lua_upvalueindex(1))) {
-			// call the function
-			lua_remove(L, 2);
-			lua_insert(L, 1);
-			lua_call(L, 1, LUA_MULTRET);
-			return lua_gettop(L);
-		}
-		lua_pop(L, 1);
-		
-		// try getting from the second upvalue (the library)
-		if(lua_gettable(L, lua_upvalueindex(2))) return 1;
-		return 0;
-	}
-}
+int api_bufferGetAt(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer offset=luaL_checkinteger(L, 2);
+	int type=typeFromArg(L, buf, 3);
+	
+	lua_Integer size=typeSize(type);
+	if(offset<0||(lua_Unsigned) offset+size>(lua_Unsigned) buffer_getSize(buf)) return 0;
+	pushValueAt(L, buffer_getCharArray(buf)+offset, type);
+	return 1;
+}
+
+/**
+ * @ref buf:setat(offset, val, [type])
+ * @ref buffer.setat(buf, offset, val, [type])
+ * writes a value at a byte offset, starting from 0, whatever the alignment
+ * does nothing if the value doesn't fit in the buffer
+ * @arg1: buffer, buf
+ * @arg2: int, offset
+ * @arg3: number, val
+ * @arg4: string|int?, type
+ */
+int api_bufferSetAt(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer offset=luaL_checkinteger(L, 2);
+	int type=typeFromArg(L, buf, 4);
+	
+	lua_Integer size=typeSize(type);
+	if(offset<0||(lua_Unsigned) offset+size>(lua_Unsigned) buffer_getSize(buf)) return 0;
+	storeValueAt(L, buffer_getCharArray(buf)+offset, type, 3);
+	return 0;
+}
+//END value getter/setter
+
+//BEGIN bulk value getter/setter
+#define load(type, sgn, luatype) case typecode(type, sgn): \
+	for(k=0; k<n; k++) { \
+		lua_push##luatype(L, buffer_get(buf, first+k, typename(sgn, type))); \
+		lua_rawseti(L, -2, k+1); \
+	} \
+	return 1;
+#define loadSwapped(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(k=0; k<n; k++) { \
+		typename(sgn, type) val; \
+		swapValue(&val, buffer_getArray(buf, typename(sgn, type))+first+k, sizeof(val)); \
+		lua_push##luatype(L, val); \
+		lua_rawseti(L, -2, k+1); \
+	} \
+	return 1;
+/**
+ * @ref buf:totable([i], [j], [type])
+ * @ref buffer.totable(buf, [i], [j], [type])
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @ret1: table, values
+ */
+int api_bufferToTable(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 4);
+	lua_Integer first, k;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	
+	lua_createtable(L, n>INT_MAX?0:n, 0);
+	switch(type) {
+		forEachType(load)
+		forEachSwappedType(loadSwapped)
+	}
+	return luaL_error(L, "unable to get value");
+}
+#undef load
+#undef loadSwapped
+
+/**
+ * @ref buf:fromtable(tbl, [i], [type])
+ * @ref buffer.fromtable(buf, tbl, [i], [type])
+ * writes the array part of the table starting at index i, stopping at the end of the buffer
+ * @arg1: buffer, buf
+ * @arg2: table, tbl
+ * @arg3: int?, i
+ * @arg4: string|int?, type
+ * @ret1: int, count
+ */
+int api_bufferFromTable(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int type=typeFromArg(L, buf, 4);
+	lua_Integer len=getLength(buf, type);
+	lua_Integer first=luaL_optinteger(L, 3, 1);
+	if(first<0) first+=len+1;
+	first--;
+	
+	lua_Integer n=lua_rawlen(L, 2);
+	if(first<0||first>=len) n=0;
+	else if(n>len-first) n=len-first;
+	
+	lua_pushinteger(L, storeValues(L, buf, type, first, n, 2, 1));
+	return 1;
+}
+
+/**
+ * @ref buf:setrange(i, ...)
+ * @ref buffer.setrange(buf, i, ...)
+ * writes the values starting at index i, as the type of the buffer, stopping at the end of the buffer
+ * @arg1: buffer, buf
+ * @arg2: int, i
+ * @arg...: number, values
+ * @ret1: int, count
+ */
+int api_bufferSetRange(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=buffer_getUser(buf)&0x3f;
+	lua_Integer len=getLength(buf, type);
+	lua_Integer first=luaL_checkinteger(L, 2);
+	if(first<0) first+=len+1;
+	first--;
+	
+	lua_Integer n=lua_gettop(L)-2;
+	if(first<0||first>=len) n=0;
+	else if(n>len-first) n=len-first;
+	
+	lua_pushinteger(L, storeValues(L, buf, type, first, n, 3, 0));
+	return 1;
+}
+//END bulk value getter/setter
+
+//BEGIN specialized accessors
+// one getter and one setter is generated per type, and used as a closure over the buffer
+#define getter(type, sgn, luatype) \
+API int getter_##sgn##type(lua_State *L) { \
+	buffer_t *buf=lua_touserdata(L, lua_upvalueindex(1)); \
+	lua_Integer idx=luaL_checkinteger(L, 1)-1; \
+	if(idx<0||(lua_Unsigned) idx>=buffer_getLength(buf, typename(sgn, type))) return 0; \
+	lua_push##luatype(L, buffer_get(buf, idx, typename(sgn, type))); \
+	return 1; \
+}
+#define setter(type, sgn, luatype) \
+API int setter_##sgn##type(lua_State *L) { \
+	buffer_t *buf=lua_touserdata(L, lua_upvalueindex(1)); \
+	lua_Integer idx=luaL_checkinteger(L, 1)-1; \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, 2); \
+	if(idx<0||(lua_Unsigned) idx>=buffer_getLength(buf, typename(U, type))) return 0; \
+	buffer_set(buf, idx, val, typename(U, type)); \
+	return 0; \
+}
+#define getterSwapped(type, sgn, luatype) \
+API int getterSwapped_##sgn##type(lua_State *L) { \
+	buffer_t *buf=lua_touserdata(L, lua_upvalueindex(1)); \
+	lua_Integer idx=luaL_checkinteger(L, 1)-1; \
+	if(idx<0||(lua_Unsigned) idx>=buffer_getLength(buf, typename(sgn, type))) return 0; \
+	typename(sgn, type) val; \
+	swapValue(&val, buffer_getArray(buf, typename(sgn, type))+idx, sizeof(val)); \
+	lua_push##luatype(L, val); \
+	return 1; \
+}
+#define setterSwapped(type, sgn, luatype) \
+API int setterSwapped_##sgn##type(lua_State *L) { \
+	buffer_t *buf=lua_touserdata(L, lua_upvalueindex(1)); \
+	lua_Integer idx=luaL_checkinteger(L, 1)-1; \
+	typename(U, type) val=(typename(U, type)) luaL_check##luatype(L, 2); \
+	if(idx<0||(lua_Unsigned) idx>=buffer_getLength(buf, typename(U, type))) return 0; \
+	swapValue(buffer_getArray(buf, typename(U, type))+idx, &val, sizeof(val)); \
+	return 0; \
+}
+forEachType(getter)
+forEachType(setter)
+forEachSwappedType(getterSwapped)
+forEachSwappedType(setterSwapped)
+#undef getter
+#undef setter
+#undef getterSwapped
+#undef setterSwapped
+
+#define getter(type, sgn, luatype) [typecode(type, sgn)]=getter_##sgn##type,
+#define setter(type, sgn, luatype) [typecode(type, sgn)]=setter_##sgn##type,
+#define getterSwapped(type, sgn, luatype) [swappedcode(type, sgn)]=getterSwapped_##sgn##type,
+#define setterSwapped(type, sgn, luatype) [swappedcode(type, sgn)]=setterSwapped_##sgn##type,
+static const lua_CFunction getters[0x40]={forEachType(getter) forEachSwappedType(getterSwapped)};
+static const lua_CFunction setters[0x40]={forEachType(setter) forEachSwappedType(setterSwapped)};
+#undef getter
+#undef setter
+#undef getterSwapped
+#undef setterSwapped
+
+/**
+ * @ref buf:getter([type])
+ * @ref buffer.getter(buf, [type])
+ * returns a function reading the buffer as a given type, which skips all the checks and dispatching of buf[idx]
+ * the function returns nil when reading out of bounds, and keeps the buffer alive
+ * @arg1: buffer, buf
+ * @arg2: string|int?, type
+ * @ret1: function, get(idx)
+ */
+int api_bufferGetter(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 2);
+	lua_settop(L, 1);
+	lua_pushcclosure(L, getters[type], 1);
+	return 1;
+}
+
+/**
+ * @ref buf:setter([type])
+ * @ref buffer.setter(buf, [type])
+ * returns a function writing the buffer as a given type, which skips all the checks and dispatching of buf[idx]=val
+ * the function silently fails when writing out of bounds, and keeps the buffer alive
+ * @arg1: buffer, buf
+ * @arg2: string|int?, type
+ * @ret1: function, set(idx, val)
+ */
+int api_bufferSetter(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 2);
+	lua_settop(L, 1);
+	lua_pushcclosure(L, setters[type], 1);
+	return 1;
+}
+//END specialized accessors
+
+//BEGIN numeric kernels
+// accumulators: integers wrap around like Lua integers, floats are summed as lua_Number
+#define ACC_integer lua_Unsigned
+#define ACC_number lua_Number
+#define acctype(luatype) ACC_##luatype
+#define pushAcc(luatype, acc) lua_push##luatype(L, (lua_##luatype) (acc))
+#define lua_integer lua_Integer
+#define lua_number lua_Number
+
+// each kernel has a task per type, run over chunks of the range by runKernel, which stores per-chunk results in the kernel
+#define elements(ptr, type, sgn) ((typename(sgn, type)*) (ptr))
+#define task(name, type, sgn) INTERNAL void name##_##sgn##type(void* ctx, buffer_size_t first, buffer_size_t last, int chunk)
+
+#define sum(type, sgn, luatype) task(sum, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	const typename(sgn, type)* p=elements(kernel->p, type, sgn); \
+	acctype(luatype) acc=0; \
+	for(buffer_size_t k=first; k<last; k++) acc+=(acctype(luatype)) p[k]; \
+	kernel->results[chunk].luatype=acc; \
+}
+forEachType(sum)
+#undef sum
+
+#define sum(type, sgn, luatype) case typecode(type, sgn): { \
+	acctype(luatype) acc=0; \
+	for(int c=runKernel(sum_##sgn##type, &kernel, n, typecode(type, sgn))-1; c>=0; c--) acc+=kernel.results[c].luatype; \
+	pushAcc(luatype, acc); \
+	return 1; \
+}
+/**
+ * @ref buf:sum([i], [j], [type])
+ * @ref buffer.sum(buf, [i], [j], [type])
+ * sums elements i to j
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @ret1: number, sum
+ */
+int api_bufferSum(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 4);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type)};
+	switch(type) {
+		forEachType(sum)
+	}
+	return luaL_error(L, "unable to get value");
+}
+#undef sum
+
+// partial extrema are stored as accumulators, which hold every value of their type exactly
+#define extremum(type, sgn, luatype) task(extremum, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	const typename(sgn, type)* p=elements(kernel->p, type, sgn); \
+	typename(sgn, type) m=p[first]; \
+	if(kernel->mode) for(buffer_size_t k=first+1; k<last; k++) m=p[k]>m?p[k]:m; \
+	else for(buffer_size_t k=first+1; k<last; k++) m=p[k]<m?p[k]:m; \
+	kernel->results[chunk].luatype=(acctype(luatype)) m; \
+}
+forEachType(extremum)
+#undef extremum
+
+#define extremum(type, sgn, luatype) case typecode(type, sgn): { \
+	int chunks=runKernel(extremum_##sgn##type, &kernel, n, typecode(type, sgn)); \
+	typename(sgn, type) m=(typename(sgn, type)) kernel.results[0].luatype; \
+	for(int c=1; c<chunks; c++) { \
+		typename(sgn, type) v=(typename(sgn, type)) kernel.results[c].luatype; \
+		m=(max?v>m:v<m)?v:m; \
+	} \
+	lua_push##luatype(L, m); \
+	return 1; \
+}
+/**
+ * @name findExtremum
+ * implementation of min and max
+ * @param L: lua_State, the Lua instance
+ * @param max: int, nonzero to find the maximum, zero for the minimum
+ * @returns int, the number of results
+ */
+int findExtremum(lua_State *L, int max) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 4);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	if(n<=0) return 0;
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type), .mode=max};
+	switch(type) {
+		forEachType(extremum)
+	}
+	return luaL_error(L, "unable to get value");
+}
+#undef extremum
+
+/**
+ * @ref buf:min([i], [j], [type])
+ * @ref buffer.min(buf, [i], [j], [type])
+ * returns the smallest of elements i to j, or nil if the range is empty
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @ret1: number?, min
+ */
+int api_bufferMin(lua_State *L) {
+	return findExtremum(L, 0);
+}
+
+/**
+ * @ref buf:max([i], [j], [type])
+ * @ref buffer.max(buf, [i], [j], [type])
+ * returns the largest of elements i to j, or nil if the range is empty
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @ret1: number?, max
+ */
+int api_bufferMax(lua_State *L) {
+	return findExtremum(L, 1);
+}
+
+#define fill(type, sgn, luatype) task(fill, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	typename(U, type)* p=elements(kernel->p, type, U); \
+	typename(U, type) val=(typename(U, type)) kernel->val.luatype; \
+	(void) chunk; \
+	for(buffer_size_t k=first; k<last; k++) p[k]=val; \
+}
+forEachType(fill)
+#undef fill
+
+#define fill(type, sgn, luatype) case typecode(type, sgn): \
+	kernel.val.luatype=luaL_check##luatype(L, 2); \
+	runKernel(fill_##sgn##type, &kernel, n, typecode(type, sgn)); \
+	return 0;
+/**
+ * @ref buf:fill(val, [i], [j], [type])
+ * @ref buffer.fill(buf, val, [i], [j], [type])
+ * sets elements i to j to val
+ * @arg1: buffer, buf
+ * @arg2: number, val
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ */
+int api_bufferFill(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 5);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 3, &first);
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type)};
+	switch(type) {
+		forEachType(fill)
+	}
+	return luaL_error(L, "unable to set value");
+}
+#undef fill
+
+// integers are scaled with integer math by whole factors, and with float math truncated towards zero otherwise, both wrapping around
+#define INTMATH_integer 1
+#define INTMATH_number 0
+#define CONVERT_integer(x) wrapInteger(x)
+#define CONVERT_number(x) (x)
+#define scale(type, sgn, luatype) task(scale, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	typename(sgn, type)* p=elements(kernel->p, type, sgn); \
+	(void) chunk; \
+	if(kernel->mode) { \
+		lua_Unsigned factor=kernel->val.integer; \
+		for(buffer_size_t k=first; k<last; k++) p[k]=(typename(sgn, type)) ((lua_Unsigned) p[k]*factor); \
+	} else { \
+		lua_Number factor=kernel->val.number; \
+		for(buffer_size_t k=first; k<last; k++) p[k]=(typename(sgn, type)) CONVERT_##luatype(p[k]*factor); \
+	} \
+}
+forEachType(scale)
+#undef scale
+
+#define scale(type, sgn, luatype) case typecode(type, sgn): \
+	kernel.val.integer=lua_tointegerx(L, 2, &kernel.mode); \
+	kernel.mode=kernel.mode&&INTMATH_##luatype; \
+	if(!kernel.mode) kernel.val.number=luaL_checknumber(L, 2); \
+	runKernel(scale_##sgn##type, &kernel, n, typecode(type, sgn)); \
+	return 0;
+/**
+ * @ref buf:scale(factor, [i], [j], [type])
+ * @ref buffer.scale(buf, factor, [i], [j], [type])
+ * multiplies elements i to j by factor
+ * integer elements multiplied by a float with a fractional part are truncated towards zero, and all integer results wrap around when they don't fit
+ * @arg1: buffer, buf
+ * @arg2: number, factor
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ */
+int api_bufferScale(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	luaL_checknumber(L, 2);
+	int type=nativeTypeFromArg(L, buf, 5);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 3, &first);
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type)};
+	switch(type) {
+		forEachType(scale)
+	}
+	return luaL_error(L, "unable to set value");
+}
+#undef scale
+
+#define add(type, sgn, luatype) task(add, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	typename(U, type)* p=elements(kernel->p, type, U); \
+	(void) chunk; \
+	if(kernel->q!=NULL) { \
+		const typename(U, type)* q=elements(kernel->q, type, U); \
+		for(buffer_size_t k=first; k<last; k++) p[k]+=q[k]; \
+	} else { \
+		typename(U, type) val=(typename(U, type)) kernel->val.luatype; \
+		for(buffer_size_t k=first; k<last; k++) p[k]+=val; \
+	} \
+}
+forEachType(add)
+#undef add
+
+#define add(type, sgn, luatype) case typecode(type, sgn): \
+	if(other==NULL) kernel.val.luatype=luaL_check##luatype(L, 2); \
+	runKernel(add_##sgn##type, &kernel, n, typecode(type, sgn)); \
+	return 0;
+/**
+ * @ref buf:add(other, [i], [j], [type])
+ * @ref buffer.add(buf, other, [i], [j], [type])
+ * adds other to elements i to j
+ * if other is a buffer, its elements i to j are added, read as the same type, and the range is clamped to both buffers
+ * if other is a number, it is added to every element
+ * integer elements wrap around
+ * @arg1: buffer, buf
+ * @arg2: buffer|number, other
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ */
+int api_bufferAdd(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	buffer_t *other=lua_type(L, 2)==LUA_TNUMBER?NULL:bufferAt(L, 2);
+	int type=nativeTypeFromArg(L, buf, 5);
+	lua_Integer len=getLength(buf, type);
+	if(other!=NULL&&getLength(other, type)<len) len=getLength(other, type);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, len, 3, &first);
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type)};
+	if(other!=NULL) kernel.q=buffer_getCharArray(other)+first*typeSize(type);
+	switch(type) {
+		forEachType(add)
+	}
+	return luaL_error(L, "unable to set value");
+}
+#undef add
+
+#define dot(type, sgn, luatype) task(dot, type, sgn) { \
+	kernel_t *kernel=ctx; \
+	const typename(sgn, type)* p=elements(kernel->p, type, sgn); \
+	const typename(sgn, type)* q=elements(kernel->q, type, sgn); \
+	acctype(luatype) acc=0; \
+	for(buffer_size_t k=first; k<last; k++) acc+=(acctype(luatype)) p[k]*(acctype(luatype)) q[k]; \
+	kernel->results[chunk].luatype=acc; \
+}
+forEachType(dot)
+#undef dot
+
+#define dot(type, sgn, luatype) case typecode(type, sgn): { \
+	acctype(luatype) acc=0; \
+	for(int c=runKernel(dot_##sgn##type, &kernel, n, typecode(type, sgn))-1; c>=0; c--) acc+=kernel.results[c].luatype; \
+	pushAcc(luatype, acc); \
+	return 1; \
+}
+/**
+ * @ref buf:dot(other, [i], [j], [type])
+ * @ref buffer.dot(buf, other, [i], [j], [type])
+ * returns the sum of the products of elements i to j of both buffers, read as the same type
+ * the range is clamped to both buffers
+ * @arg1: buffer, buf
+ * @arg2: buffer, other
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ * @ret1: number, dot
+ */
+int api_bufferDot(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	buffer_t *other=bufferAt(L, 2);
+	int type=nativeTypeFromArg(L, buf, 5);
+	lua_Integer len=getLength(buf, type);
+	if(getLength(other, type)<len) len=getLength(other, type);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, len, 3, &first);
+	kernel_t kernel={.p=buffer_getCharArray(buf)+first*typeSize(type), .q=buffer_getCharArray(other)+first*typeSize(type)};
+	switch(type) {
+		forEachType(dot)
+	}
+	return luaL_error(L, "unable to get value");
+}
+#undef dot
+
+#undef task
+#undef elements
+#undef pushAcc
+#undef acctype
+#undef lua_integer
+#undef lua_number
+
+/**
+ * @ref buf:foreach(fn, [i], [j], [type])
+ * @ref buffer.foreach(buf, fn, [i], [j], [type])
+ * calls fn(value, index) for elements i to j
+ * fn may resize buf, but an error is raised once the next element no longer exists
+ * this calls back into Lua for every element, so the built-in kernels should be preferred when possible
+ * @arg1: buffer, buf
+ * @arg2: function, fn
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ */
+int api_bufferForeach(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	int type=typeFromArg(L, buf, 5);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 3, &first);
+	
+	for(lua_Integer k=first; k<first+n; k++) {
+		// fn may have resized the buffer, so the bound is checked again for every element
+		if(k>=getLength(buf, type)) return luaL_error(L, "buffer was shrunk during foreach, element #%I is gone", k+1);
+		lua_pushvalue(L, 2);
+		pushValue(L, buf, type, k);
+		lua_pushinteger(L, k+1);
+		lua_call(L, 2, 0);
+	}
+	return 0;
+}
+
+/**
+ * @ref buf:map(fn, [inplace], [i], [j], [type])
+ * @ref buffer.map(buf, fn, [inplace], [i], [j], [type])
+ * replaces elements i to j with the result of fn(value, index)
+ * unless inplace is true, the results are written to a new buffer holding only the range, which is returned
+ * fn may resize buf, but an error is raised once the current element no longer exists
+ * this calls back into Lua for every element, so the built-in kernels should be preferred when possible
+ * @arg1: buffer, buf
+ * @arg2: function, fn
+ * @arg3: boolean?, inplace
+ * @arg4: int?, i
+ * @arg5: int?, j
+ * @arg6: string|int?, type
+ * @ret1: buffer?, result
+ */
+int api_bufferMap(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	int inplace=lua_toboolean(L, 3);
+	int type=typeFromArg(L, buf, 6);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 4, &first);
+	
+	buffer_t *dst=buf;
+	lua_Integer offset=0;
+	if(!inplace) {
+		if(n<=0) return luaL_argerror(L, 4, "cannot create an empty buffer");
+		dst=pushBuffer(L, n*typeSize(type));
+		buffer_setUser(dst, type);
+		offset=first;
+	}
+	
+	for(lua_Integer k=first; k<first+n; k++) {
+		// fn may have resized the buffer, so the bound is checked again before reading and writing
+		if(k>=getLength(buf, type)) return luaL_error(L, "buffer was shrunk during map, element #%I is gone", k+1);
+		lua_pushvalue(L, 2);
+		pushValue(L, buf, type, k);
+		lua_pushinteger(L, k+1);
+		lua_call(L, 2, 1);
+		if(isFloatType(type)) numberAt(L, -1, k+1);
+		else integerAt(L, -1, k+1);
+		if(inplace&&k>=getLength(buf, type)) return luaL_error(L, "buffer was shrunk during map, element #%I is gone", k+1);
+		storeValues(L, dst, type, k-offset, 1, -1, 0);
+		lua_pop(L, 1);
+	}
+	return inplace?0:1;
+}
+//END numeric kernels
+
+//BEGIN type conversion
+// conversions go through blocks of lua_Integer when both types are integers and the scale is an integer, and of lua_Number otherwise
+#define CONVERT_BLOCK 256
+
+// range of each integer type, used when saturating
+#define MAX_U(type) ((typename(U, type)) -1)
+#define MAX_S(type) ((typename(S, type)) (MAX_U(type)>>1))
+#define MIN_U(type) 0
+#define MIN_S(type) (-MAX_S(type)-1)
+
+#define loadNumber(type, sgn, luatype) case typecode(type, sgn): \
+	for(int k=0; k<n; k++) tmp[k]=(lua_Number) ((const typename(sgn, type)*) src)[k]; \
+	return;
+#define loadSwappedNumber(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(int k=0; k<n; k++) { \
+		typename(sgn, type) val; \
+		swapValue(&val, src+k*sizeof(val), sizeof(val)); \
+		tmp[k]=(lua_Number) val; \
+	} \
+	return;
+/**
+ * @name loadNumbers
+ * reads a block of values of any type as Lua numbers
+ * @param tmp: lua_Number*, the block
+ * @param src: char*, the first value
+ * @param type: int, the type of the values
+ * @param n: int, the number of values
+ */
+void loadNumbers(lua_Number *tmp, const char *src, int type, int n) {
+	switch(type) {
+		forEachType(loadNumber)
+		forEachSwappedType(loadSwappedNumber)
+	}
+}
+#undef loadNumber
+#undef loadSwappedNumber
+
+#define loadInteger(type, sgn, luatype) case typecode(type, sgn): \
+	for(int k=0; k<n; k++) tmp[k]=(lua_Integer) ((const typename(sgn, type)*) src)[k]; \
+	return;
+#define loadSwappedInteger(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(int k=0; k<n; k++) { \
+		typename(sgn, type) val; \
+		swapValue(&val, src+k*sizeof(val), sizeof(val)); \
+		tmp[k]=(lua_Integer) val; \
+	} \
+	return;
+/**
+ * @name loadIntegers
+ * reads a block of values of an integer type as Lua integers, which unsigned 64 bit values wrap around to
+ * @param tmp: lua_Integer*, the block
+ * @param src: char*, the first value
+ * @param type: int, the type of the values
+ * @param n: int, the number of values
+ */
+void loadIntegers(lua_Integer *tmp, const char *src, int type, int n) {
+	switch(type) {
+		forEachType(loadInteger)
+		forEachSwappedType(loadSwappedInteger)
+	}
+}
+#undef loadInteger
+#undef loadSwappedInteger
+
+// floats converted to integers are truncated towards zero, and either wrap around or saturate, NaN giving zero
+#define FROMNUMBER_integer(type, sgn, v) (saturate? \
+	((v)!=(v)?(typename(sgn, type)) 0: \
+	(v)<=(lua_Number) MIN_##sgn(type)?(typename(sgn, type)) MIN_##sgn(type): \
+	(v)>=(lua_Number) MAX_##sgn(type)?(typename(sgn, type)) MAX_##sgn(type): \
+	(typename(sgn, type)) (v)): \
+	(typename(sgn, type)) wrapInteger(v))
+#define FROMNUMBER_number(type, sgn, v) ((typename(sgn, type)) (v))
+#define storeNumber(type, sgn, luatype) case typecode(type, sgn): \
+	for(int k=0; k<n; k++) ((typename(sgn, type)*) dst)[k]=FROMNUMBER_##luatype(type, sgn, tmp[k]); \
+	return;
+#define storeSwappedNumber(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(int k=0; k<n; k++) { \
+		typename(sgn, type) val=FROMNUMBER_##luatype(type, sgn, tmp[k]); \
+		swapValue(dst+k*sizeof(val), &val, sizeof(val)); \
+	} \
+	return;
+/**
+ * @name storeNumbers
+ * writes a block of Lua numbers as values of any type
+ * @param dst: char*, the first value
+ * @param type: int, the type of the values
+ * @param tmp: lua_Number*, the block
+ * @param n: int, the number of values
+ * @param saturate: int, nonzero to clamp values to the range of integer types instead of wrapping around
+ */
+void storeNumbers(char *dst, int type, const lua_Number *tmp, int n, int saturate) {
+	switch(type) {
+		forEachType(storeNumber)
+		forEachSwappedType(storeSwappedNumber)
+	}
+}
+#undef storeNumber
+#undef storeSwappedNumber
+#undef FROMNUMBER_integer
+#undef FROMNUMBER_number
+
+// integers only ever get stored as integer types
+#define FROMINTEGER_integer(type, sgn, v) (saturate? \
+	((v)<(lua_Integer) MIN_##sgn(type)?(typename(sgn, type)) MIN_##sgn(type): \
+	(v)>=0&&(lua_Unsigned) (v)>(lua_Unsigned) MAX_##sgn(type)?(typename(sgn, type)) MAX_##sgn(type): \
+	(typename(sgn, type)) (v)): \
+	(typename(sgn, type)) (lua_Unsigned) (v))
+#define FROMINTEGER_number(type, sgn, v) ((typename(sgn, type)) (v))
+#define storeInteger(type, sgn, luatype) case typecode(type, sgn): \
+	for(int k=0; k<n; k++) ((typename(sgn, type)*) dst)[k]=FROMINTEGER_##luatype(type, sgn, tmp[k]); \
+	return;
+#define storeSwappedInteger(type, sgn, luatype) case swappedcode(type, sgn): \
+	for(int k=0; k<n; k++) { \
+		typename(sgn, type) val=FROMINTEGER_##luatype(type, sgn, tmp[k]); \
+		swapValue(dst+k*sizeof(val), &val, sizeof(val)); \
+	} \
+	return;
+/**
+ * @name storeIntegers
+ * writes a block of Lua integers as values of an integer type
+ * @param dst: char*, the first value
+ * @param type: int, the type of the values
+ * @param tmp: lua_Integer*, the block
+ * @param n: int, the number of values
+ * @param saturate: int, nonzero to clamp values to the range of the type instead of wrapping around
+ */
+void storeIntegers(char *dst, int type, const lua_Integer *tmp, int n, int saturate) {
+	switch(type) {
+		forEachType(storeInteger)
+		forEachSwappedType(storeSwappedInteger)
+	}
+}
+#undef storeInteger
+#undef storeSwappedInteger
+#undef FROMINTEGER_integer
+#undef FROMINTEGER_number
+
+#undef MAX_U
+#undef MAX_S
+#undef MIN_U
+#undef MIN_S
+
+// specialized conversions between common types, as plain loops the compiler vectorizes for each instruction set
+// conversions from floats to integers are only specialized when saturating, as wrapping around can't be vectorized
+#define convertLoop(name, attr, stype, dtype, ftype) \
+attr INTERNAL void name(void *restrict dst, const void *restrict src, buffer_size_t n, lua_Number scale) { \
+	const stype *s=src; \
+	dtype *d=dst; \
+	ftype factor=(ftype) scale; \
+	for(buffer_size_t k=0; k<n; k++) d[k]=(dtype) ((ftype) s[k]*factor); \
+}
+#define saturateLoop(name, attr, stype, dtype, ftype, lo, hi) \
+attr INTERNAL void name(void *restrict dst, const void *restrict src, buffer_size_t n, lua_Number scale) { \
+	const stype *s=src; \
+	dtype *d=dst; \
+	ftype factor=(ftype) scale; \
+	for(buffer_size_t k=0; k<n; k++) { \
+		ftype v=(ftype) s[k]*factor; \
+		v=v==v?v:0; \
+		v=v<lo?lo:v; \
+		v=v>hi?hi:v; \
+		d[k]=(dtype) v; \
+	} \
+}
+#define conversionLoops(suffix, attr) \
+	convertLoop(convertS16Float##suffix, attr, int16_t, float, float) \
+	convertLoop(convertU8Float##suffix, attr, uint8_t, float, float) \
+	convertLoop(convertFloatDouble##suffix, attr, float, double, double) \
+	convertLoop(convertDoubleFloat##suffix, attr, double, float, double) \
+	convertLoop(convertS32Double##suffix, attr, int32_t, double, double) \
+	saturateLoop(convertFloatS16##suffix, attr, float, int16_t, float, -32768.0f, 32767.0f) \
+	saturateLoop(convertFloatU8##suffix, attr, float, uint8_t, float, 0.0f, 255.0f) \
+	saturateLoop(convertDoubleS32##suffix, attr, double, int32_t, double, -2147483648.0, 2147483647.0)
+#define conversionTable(suffix) { \
+	{KIND_S16, KIND_FLOAT, 0, convertS16Float##suffix}, \
+	{KIND_U8, KIND_FLOAT, 0, convertU8Float##suffix}, \
+	{KIND_FLOAT, KIND_DOUBLE, 0, convertFloatDouble##suffix}, \
+	{KIND_DOUBLE, KIND_FLOAT, 0, convertDoubleFloat##suffix}, \
+	{KIND_S32, KIND_DOUBLE, 0, convertS32Double##suffix}, \
+	{KIND_FLOAT, KIND_S16, 1, convertFloatS16##suffix}, \
+	{KIND_FLOAT, KIND_U8, 1, convertFloatU8##suffix}, \
+	{KIND_DOUBLE, KIND_S32, 1, convertDoubleS32##suffix}, \
+	{-1, -1, 0, NULL} \
+}
+
+conversionLoops(, )
+static const conversion_t baseConversions[]=conversionTable();
+#ifdef BUFFER_X86_SIMD
+conversionLoops(AVX2, __attribute__((target("avx2"))))
+static const conversion_t avx2Conversions[]=conversionTable(AVX2);
+#endif
+#undef convertLoop
+#undef saturateLoop
+#undef conversionLoops
+#undef conversionTable
+
+// runtime dispatch, resolved when the library is loaded so that states running on different threads never race on it
+static const conversion_t *conversions=baseConversions;
+
+#ifdef BUFFER_X86_SIMD
+/**
+ * @name resolveConversions
+ * picks the specialized conversions for the CPU
+ */
+__attribute__((constructor))
+void resolveConversions(void) {
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) conversions=avx2Conversions;
+}
+#endif
+
+/**
+ * @name convertKind
+ * determines whether a type has specialized conversions
+ * @param type: int, the type
+ * @returns int, the kind of the type, -1 if it has none
+ */
+int convertKind(int type) {
+	if(type&TYPE_SWAPPED) return -1;
+	if((type&0xf)==TYPE_FLOAT) return KIND_FLOAT;
+#ifdef TYPE_DOUBLE
+	if((type&0xf)==TYPE_DOUBLE) return KIND_DOUBLE;
+#endif
+	int size=typeSize(type);
+	if(size==1&&!(type&TYPE_SIGNED)) return KIND_U8;
+	if(size==2&&(type&TYPE_SIGNED)) return KIND_S16;
+	if(size==4&&(type&TYPE_SIGNED)) return KIND_S32;
+	return -1;
+}
+
+/**
+ * @name findConversion
+ * finds the specialized conversion between two types, if there is one
+ * @param srctype: int, the type of the values read
+ * @param dsttype: int, the type of the values written
+ * @param saturate: int, nonzero if integers saturate
+ * @returns convertFn, the conversion, NULL if there is none
+ */
+convertFn findConversion(int srctype, int dsttype, int saturate) {
+	int src=convertKind(srctype), dst=convertKind(dsttype);
+	for(const conversion_t *conv=conversions; conv->fn!=NULL; conv++) {
+		if(conv->src==src&&conv->dst==dst&&conv->saturating<=saturate) return conv->fn;
+	}
+	return NULL;
+}
+
+/**
+ * @name convertTask
+ * converts a chunk of values, see buffer_parallel
+ * @param ctx: convertjob_t*, the conversion
+ * @param first: buffer_size_t, the first value of the chunk
+ * @param last: buffer_size_t, the value after the chunk
+ * @param chunk: int, the number of the chunk
+ */
+void convertTask(void* ctx, buffer_size_t first, buffer_size_t last, int chunk) {
+	convertjob_t *job=ctx;
+	int ssize=typeSize(job->srctype), dsize=typeSize(job->dsttype);
+	(void) chunk;
+	
+	if(job->fast!=NULL) {
+		job->fast(job->dst+first*dsize, job->src+first*ssize, last-first, job->scale.number);
+		return;
+	}
+	
+	for(buffer_size_t k=first; k<last; k+=CONVERT_BLOCK) {
+		int n=last-k<CONVERT_BLOCK?(int) (last-k):CONVERT_BLOCK;
+		if(job->integer) {
+			lua_Integer tmp[CONVERT_BLOCK];
+			loadIntegers(tmp, job->src+k*ssize, job->srctype, n);
+			if(job->scale.integer!=1) for(int i=0; i<n; i++) tmp[i]=(lua_Integer) ((lua_Unsigned) tmp[i]*job->scale.integer);
+			storeIntegers(job->dst+k*dsize, job->dsttype, tmp, n, job->saturate);
+		} else {
+			lua_Number tmp[CONVERT_BLOCK];
+			loadNumbers(tmp, job->src+k*ssize, job->srctype, n);
+			if(job->scale.number!=1) for(int i=0; i<n; i++) tmp[i]*=job->scale.number;
+			storeNumbers(job->dst+k*dsize, job->dsttype, tmp, n, job->saturate);
+		}
+	}
+}
+
+/**
+ * @ref src:convert(srctype, dst, dsttype, [scale], [saturate])
+ * @ref buffer.convert(src, srctype, dst, dsttype, [scale], [saturate])
+ * converts the values of src, read as srctype, to dsttype in dst, multiplying them by scale
+ * both types default to the type of their buffer, and the conversion stops at the end of the shortest buffer
+ * integers are converted exactly when both types are integers and the scale is a whole number, and as Lua numbers otherwise
+ * numbers converted to integers are truncated towards zero, and wrap around, or are clamped to the range of the type when saturate is true
+ * src and dst may only overlap when they start at the same byte and both types have the same size
+ * @arg1: buffer, src
+ * @arg2: string|int?, srctype
+ * @arg3: buffer, dst
+ * @arg4: string|int?, dsttype
+ * @arg5: number?, scale
+ * @arg6: boolean?, saturate
+ * @ret1: int, count
+ */
+int api_bufferConvert(lua_State *L) {
+	buffer_t *src=bufferFromArg(L);
+	buffer_t *dst=bufferAt(L, 3);
+	convertjob_t job;
+	job.srctype=typeFromArg(L, src, 2);
+	job.dsttype=typeFromArg(L, dst, 4);
+	job.saturate=lua_toboolean(L, 6);
+	int ssize=typeSize(job.srctype), dsize=typeSize(job.dsttype);
+	
+	lua_Integer n=getLength(src, job.srctype);
+	if(getLength(dst, job.dsttype)<n) n=getLength(dst, job.dsttype);
+	job.src=buffer_getCharArray(src);
+	job.dst=buffer_getCharArray(dst);
+	
+	// the chunks of the conversion run in any order, so they must not write over values other chunks read
+	int same=job.src==job.dst&&ssize==dsize;
+	if(!same&&n>0&&(uintptr_t) job.dst<(uintptr_t) job.src+n*ssize&&(uintptr_t) job.src<(uintptr_t) job.dst+n*dsize) return luaL_argerror(L, 3, "overlaps src");
+	
+	// integer types are converted with integer math, through the bits of the values, unless the scale has a fractional part
+	int isint=lua_isnoneornil(L, 5);
+	lua_Integer scale=isint?1:lua_tointegerx(L, 5, &isint);
+	job.integer=!isFloatType(job.srctype)&&!isFloatType(job.dsttype)&&isint;
+	if(job.integer) job.scale.integer=scale;
+	else job.scale.number=luaL_optnumber(L, 5, 1);
+	job.fast=job.integer||same?NULL:findConversion(job.srctype, job.dsttype, job.saturate);
+	
+	int size=ssize>dsize?ssize:dsize;
+	if(n>0) buffer_parallel((buffer_size_t) n, BUFFER_PARALLEL_GRAIN/size, convertTask, &job);
+	lua_pushinteger(L, n);
+	return 1;
+}
+//END type conversion
+
+//BEGIN sorting
+// integers are sorted by their bits, a byte at a time, with the sign bit of signed types flipped so that negative values come first
+// ranges shorter than RADIX_MIN are sorted by insertion instead, as a radix pass costs at least 256 steps
+#define RADIX_MIN 64
+#define radixSorts(bits) \
+INTERNAL int radixSort##bits(uint##bits##_t *a, size_t n, uint##bits##_t flip) { \
+	if(n<RADIX_MIN) { \
+		for(size_t k=1; k<n; k++) { \
+			uint##bits##_t v=a[k]; \
+			size_t i=k; \
+			for(; i>0&&(uint##bits##_t) (a[i-1]^flip)>(uint##bits##_t) (v^flip); i--) a[i]=a[i-1]; \
+			a[i]=v; \
+		} \
+		return 1; \
+	} \
+	uint##bits##_t *tmp=malloc(n*sizeof(uint##bits##_t)); \
+	if(tmp==NULL) return 0; \
+	\
+	size_t counts[bits/8][256]={{0}}; \
+	for(size_t k=0; k<n; k++) { \
+		uint##bits##_t key=a[k]^flip; \
+		for(int b=0; b<bits/8; b++) counts[b][(key>>(8*b))&0xff]++; \
+	} \
+	\
+	uint##bits##_t *src=a, *dst=tmp; \
+	for(int b=0; b<bits/8; b++) { \
+		size_t *count=counts[b]; \
+		/* bytes shared by every key don't need a pass */ \
+		if(count[((uint##bits##_t) (src[0]^flip)>>(8*b))&0xff]==n) continue; \
+		for(size_t d=0, sum=0; d<256; d++) { \
+			size_t c=count[d]; \
+			count[d]=sum; \
+			sum+=c; \
+		} \
+		for(size_t k=0; k<n; k++) dst[count[((uint##bits##_t) (src[k]^flip)>>(8*b))&0xff]++]=src[k]; \
+		uint##bits##_t *swap=src; \
+		src=dst; \
+		dst=swap; \
+	} \
+	\
+	if(src!=a) memcpy(a, src, n*sizeof(uint##bits##_t)); \
+	free(tmp); \
+	return 1; \
+} \
+INTERNAL int radixArgsort##bits(const uint##bits##_t *a, T_INDEX *idx, size_t n, uint##bits##_t flip, int descending, T_INDEX base) { \
+	/* descending keys are complemented rather than reversed, which keeps equal elements in order */ \
+	uint##bits##_t mask=descending?(uint##bits##_t) ~flip:flip; \
+	uint##bits##_t *keys=malloc(2*n*sizeof(uint##bits##_t)); \
+	T_INDEX *tmp=malloc(n*sizeof(T_INDEX)); \
+	if(keys==NULL||tmp==NULL) { \
+		free(keys); \
+		free(tmp); \
+		return 0; \
+	} \
+	\
+	size_t counts[bits/8][256]={{0}}; \
+	for(size_t k=0; k<n; k++) { \
+		keys[k]=a[k]^mask; \
+		idx[k]=base+(T_INDEX) k; \
+		for(int b=0; b<bits/8; b++) counts[b][(keys[k]>>(8*b))&0xff]++; \
+	} \
+	\
+	uint##bits##_t *ksrc=keys, *kdst=keys+n; \
+	T_INDEX *isrc=idx, *idst=tmp; \
+	for(int b=0; b<bits/8; b++) { \
+		size_t *count=counts[b]; \
+		if(count[(ksrc[0]>>(8*b))&0xff]==n) continue; \
+		for(size_t d=0, sum=0; d<256; d++) { \
+			size_t c=count[d]; \
+			count[d]=sum; \
+			sum+=c; \
+		} \
+		for(size_t k=0; k<n; k++) { \
+			size_t pos=count[(ksrc[k]>>(8*b))&0xff]++; \
+			kdst[pos]=ksrc[k]; \
+			idst[pos]=isrc[k]; \
+		} \
+		uint##bits##_t *kswap=ksrc; \
+		ksrc=kdst; \
+		kdst=kswap; \
+		T_INDEX *iswap=isrc; \
+		isrc=idst; \
+		idst=iswap; \
+	} \
+	\
+	if(isrc!=idx) memcpy(idx, isrc, n*sizeof(T_INDEX)); \
+	free(keys); \
+	free(tmp); \
+	return 1; \
+}
+radixSorts(8)
+radixSorts(16)
+radixSorts(32)
+radixSorts(64)
+#undef radixSorts
+
+// floats are sorted by introsort: quicksort with a median of three pivot, which falls back to heapsort when it recurses too deep
+// partitions shorter than INTROSORT_MIN are left to a final insertion sort
+// NaNs compare with nothing, so they are moved to the end beforehand
+#define INTROSORT_MIN 16
+#define swapElements(T, x, y) do { \
+	T swap=(x); \
+	(x)=(y); \
+	(y)=swap; \
+} while(0)
+#define introsort(name, T, less) \
+INTERNAL void name##Sift(T *a, size_t root, size_t n) { \
+	for(size_t child; (child=2*root+1)<n; root=child) { \
+		if(child+1<n&&less(a[child], a[child+1])) child++; \
+		if(!less(a[root], a[child])) return; \
+		swapElements(T, a[root], a[child]); \
+	} \
+} \
+INTERNAL void name(T *a, size_t n, int depth) { \
+	while(n>INTROSORT_MIN) { \
+		if(depth--<=0) { \
+			for(size_t k=n/2; k-->0; ) name##Sift(a, k, n); \
+			for(size_t k=n-1; k>0; k--) { \
+				swapElements(T, a[0], a[k]); \
+				name##Sift(a, 0, k); \
+			} \
+			return; \
+		} \
+		\
+		/* the median of the first, middle and last elements becomes the first one, and the pivot */ \
+		size_t mid=n/2; \
+		if(less(a[mid], a[0])) swapElements(T, a[mid], a[0]); \
+		if(less(a[n-1], a[mid])) swapElements(T, a[n-1], a[mid]); \
+		if(less(a[mid], a[0])) swapElements(T, a[mid], a[0]); \
+		swapElements(T, a[0], a[mid]); \
+		T pivot=a[0]; \
+		\
+		/* Hoare partition: afterwards a[0..j] are at most the pivot and a[j+1..n-1] at least the pivot, and neither side is empty */ \
+		size_t i=(size_t) -1, j=n; \
+		for(;;) { \
+			do i++; while(less(a[i], pivot)); \
+			do j--; while(less(pivot, a[j])); \
+			if(i>=j) break; \
+			swapElements(T, a[i], a[j]); \
+		} \
+		\
+		/* recursing into the smaller side bounds the stack */ \
+		size_t left=j+1; \
+		if(left<n-left) { \
+			name(a, left, depth); \
+			a+=left; \
+			n-=left; \
+		} else { \
+			name(a+left, n-left, depth); \
+			n=left; \
+		} \
+	} \
+	\
+	for(size_t k=1; k<n; k++) { \
+		T v=a[k]; \
+		size_t i=k; \
+		for(; i>0&&less(v, a[i-1]); i--) a[i]=a[i-1]; \
+		a[i]=v; \
+	} \
+}
+
+// argsort sorts pairs of keys and indices, with ties broken by index, which makes it stable
+#define lessValue(x, y) ((x)<(y))
+#define lessPair(x, y) ((x).key<(y).key||((x).key==(y).key&&(x).idx<(y).idx))
+#define floatSorts(name, T) \
+typedef struct { \
+	T key; \
+	T_INDEX idx; \
+} name##pair_t; \
+introsort(introsort##name, T, lessValue) \
+introsort(introsort##name##Pairs, name##pair_t, lessPair) \
+INTERNAL void sort##name(T *a, size_t n, int descending) { \
+	size_t count=n; \
+	for(size_t k=0; k<count; ) { \
+		if(a[k]==a[k]) k++; \
+		else { \
+			count--; \
+			swapElements(T, a[k], a[count]); \
+		} \
+	} \
+	introsort##name(a, count, 2*sortDepth(count)); \
+	if(descending) for(size_t k=0; k<count/2; k++) swapElements(T, a[k], a[count-1-k]); \
+} \
+INTERNAL int argsort##name(const T *a, T_INDEX *idx, size_t n, int descending, T_INDEX base) { \
+	name##pair_t *pairs=malloc(n*sizeof(name##pair_t)); \
+	if(pairs==NULL) return 0; \
+	\
+	/* descending keys are negated rather than reversed, which keeps equal elements in order */ \
+	size_t count=0, nans=n; \
+	for(size_t k=0; k<n; k++) { \
+		if(a[k]!=a[k]) continue; \
+		pairs[count].key=descending?-a[k]:a[k]; \
+		pairs[count++].idx=base+(T_INDEX) k; \
+	} \
+	introsort##name##Pairs(pairs, count, 2*sortDepth(count)); \
+	\
+	for(size_t k=0; k<count; k++) idx[k]=pairs[k].idx; \
+	for(size_t k=n; k-->0; ) if(a[k]!=a[k]) idx[--nans]=base+(T_INDEX) k; \
+	free(pairs); \
+	return 1; \
+}
+floatSorts(Float, float)
+#ifdef TYPE_DOUBLE
+floatSorts(Double, double)
+#endif
+#undef floatSorts
+#undef lessValue
+#undef lessPair
+#undef introsort
+#undef swapElements
+
+/**
+ * @name sortDepth
+ * computes the base 2 logarithm of a length, which bounds the depth of introsort
+ * @param n: size_t, the length
+ * @returns int, the logarithm
+ */
+int sortDepth(size_t n) {
+	int depth=0;
+	while(n>1) {
+		n>>=1;
+		depth++;
+	}
+	return depth;
+}
+
+/**
+ * @ref buf:sort([i], [j], [type], [descending])
+ * @ref buffer.sort(buf, [i], [j], [type], [descending])
+ * sorts elements i to j in place, in ascending order unless descending is true
+ * integers are sorted by radix sort, and floats by introsort, with NaNs moved to the end
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @arg5: boolean?, descending
+ */
+int api_bufferSort(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 4);
+	int descending=lua_toboolean(L, 5);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	if(n<2) return 0;
+	int size=typeSize(type);
+	char *p=buffer_getCharArray(buf)+first*size;
+	
+	if((type&0xf)==TYPE_FLOAT) {
+		sortFloat((float*) p, n, descending);
+		return 0;
+	}
+#ifdef TYPE_DOUBLE
+	if((type&0xf)==TYPE_DOUBLE) {
+		sortDouble((double*) p, n, descending);
+		return 0;
+	}
+#endif
+	
+	int sgn=type&TYPE_SIGNED;
+	int ok=0;
+	switch(size) {
+		case 1:
+			ok=radixSort8((uint8_t*) p, n, sgn?(uint8_t) 1<<7:0);
+			break;
+		case 2:
+			ok=radixSort16((uint16_t*) p, n, sgn?(uint16_t) 1<<15:0);
+			break;
+		case 4:
+			ok=radixSort32((uint32_t*) p, n, sgn?(uint32_t) 1<<31:0);
+			break;
+		case 8:
+			ok=radixSort64((uint64_t*) p, n, sgn?(uint64_t) 1<<63:0);
+			break;
+	}
+	if(!ok) return luaL_error(L, "failed to allocate sorting memory");
+	
+	// equal integers are indistinguishable, so the order can simply be reversed
+	if(descending) {
+		char tmp[8];
+		for(lua_Integer k=0; k<n/2; k++) {
+			memcpy(tmp, p+k*size, size);
+			memcpy(p+k*size, p+(n-1-k)*size, size);
+			memcpy(p+(n-1-k)*size, tmp, size);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @ref buf:argsort([i], [j], [type], [descending])
+ * @ref buffer.argsort(buf, [i], [j], [type], [descending])
+ * returns the indices of elements i to j in the order which sorts them, without modifying the buffer
+ * equal elements keep their order, and NaNs come last
+ * the indices are returned as a buffer of signed 64-bit integers (32-bit if unavailable)
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ * @arg5: boolean?, descending
+ * @ret1: buffer?, indices
+ */
+int api_bufferArgsort(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 4);
+	int descending=lua_toboolean(L, 5);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	if(n<=0) return 0;
+	int size=typeSize(type);
+	const char *p=buffer_getCharArray(buf)+first*size;
+	
+	buffer_t *indices=pushBuffer(L, n*sizeof(T_INDEX));
+	buffer_setUser(indices, TYPE_INDEX);
+	T_INDEX *idx=buffer_getArray(indices, T_INDEX);
+	T_INDEX base=(T_INDEX) first+1;
+	
+	int sgn=type&TYPE_SIGNED;
+	int ok=0;
+	if((type&0xf)==TYPE_FLOAT) ok=argsortFloat((const float*) p, idx, n, descending, base);
+#ifdef TYPE_DOUBLE
+	else if((type&0xf)==TYPE_DOUBLE) ok=argsortDouble((const double*) p, idx, n, descending, base);
+#endif
+	else switch(size) {
+		case 1:
+			ok=radixArgsort8((const uint8_t*) p, idx, n, sgn?(uint8_t) 1<<7:0, descending, base);
+			break;
+		case 2:
+			ok=radixArgsort16((const uint16_t*) p, idx, n, sgn?(uint16_t) 1<<15:0, descending, base);
+			break;
+		case 4:
+			ok=radixArgsort32((const uint32_t*) p, idx, n, sgn?(uint32_t) 1<<31:0, descending, base);
+			break;
+		case 8:
+			ok=radixArgsort64((const uint64_t*) p, idx, n, sgn?(uint64_t) 1<<63:0, descending, base);
+			break;
+	}
+	if(!ok) return luaL_error(L, "failed to allocate sorting memory");
+	return 1;
+}
+
+// comparisons between elements and Lua values, where unsigned elements are above every negative value
+#define below_integer(sgn, elem, val) BELOW_##sgn(elem, val)
+#define below_number(sgn, elem, val) ((lua_Number) (elem)<(val))
+#define above_integer(sgn, elem, val) ABOVE_##sgn(elem, val)
+#define above_number(sgn, elem, val) ((lua_Number) (elem)>(val))
+#define BELOW_S(elem, val) ((lua_Integer) (elem)<(val))
+#define ABOVE_S(elem, val) ((lua_Integer) (elem)>(val))
+#define BELOW_U(elem, val) ((val)>=0&&(lua_Unsigned) (elem)<(lua_Unsigned) (val))
+#define ABOVE_U(elem, val) ((val)<0||(lua_Unsigned) (elem)>(lua_Unsigned) (val))
+#define search(type, sgn, luatype) case typecode(type, sgn): { \
+	const typename(sgn, type)* p=buffer_getArray(buf, typename(sgn, type)); \
+	lua_##luatype val=luaL_check##luatype(L, 2); \
+	while(lo<hi) { \
+		lua_Integer mid=lo+(hi-lo)/2; \
+		if(descending?above_##luatype(sgn, p[mid], val):below_##luatype(sgn, p[mid], val)) lo=mid+1; \
+		else hi=mid; \
+	} \
+	found=lo<end&&!(descending?below_##luatype(sgn, p[lo], val):above_##luatype(sgn, p[lo], val)); \
+	break; \
+}
+#define lua_integer lua_Integer
+#define lua_number lua_Number
+/**
+ * @ref buf:bsearch(val, [i], [j], [type], [descending])
+ * @ref buffer.bsearch(buf, val, [i], [j], [type], [descending])
+ * finds where val belongs among elements i to j, which must be sorted, in descending order if descending is true
+ * returns the index of the first element which doesn't come before val, or j+1 if there is none, which is where val would be inserted
+ * @arg1: buffer, buf
+ * @arg2: number, val
+ * @arg3: int?, i
+ * @arg4: int?, j
+ * @arg5: string|int?, type
+ * @arg6: boolean?, descending
+ * @ret1: int, idx
+ * @ret2: boolean, whether the element at idx is equal to val
+ */
+int api_bufferBsearch(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=nativeTypeFromArg(L, buf, 5);
+	int descending=lua_toboolean(L, 6);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 3, &first);
+	lua_Integer lo=first, hi=first+n, end=first+n;
+	int found=0;
+	switch(type) {
+		forEachType(search)
+		default:
+			return luaL_error(L, "unable to get value");
+	}
+	lua_pushinteger(L, lo+1);
+	lua_pushboolean(L, found);
+	return 2;
+}
+#undef search
+#undef below_integer
+#undef below_number
+#undef above_integer
+#undef above_number
+#undef BELOW_S
+#undef ABOVE_S
+#undef BELOW_U
+#undef ABOVE_U
+#undef lua_integer
+#undef lua_number
+//END sorting
+
+//BEGIN byte order
+/**
+ * @ref buf:byteswap([i], [j], [type])
+ * @ref buffer.byteswap(buf, [i], [j], [type])
+ * reverses the bytes of elements i to j in place, converting them between big and little endian
+ * this allows using the numeric kernels on data stored in the opposite byte order
+ * @arg1: buffer, buf
+ * @arg2: int?, i
+ * @arg3: int?, j
+ * @arg4: string|int?, type
+ */
+int api_bufferByteswap(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	int type=typeFromArg(L, buf, 4);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, getLength(buf, type), 2, &first);
+	if(n>0) buffer_byteswap(buf, first, n, typeSize(type));
+	return 0;
+}
+//END byte order
+
+//BEGIN records
+/**
+ * @name compileFormat
+ * compiles a format string into a list of fields, and pushes it on the stack
+ * the format works like the one of string.pack, without alignment nor strings:
+ * b/B: signed/unsigned int8
+ * h/H: signed/unsigned int16
+ * i[n]/I[n]: signed/unsigned integer of n bytes, 4 by default
+ * l/L, j/J: signed/unsigned int64, and integer of the size of a Lua integer
+ * f/d: float/double
+ * x: one byte of padding
+ * </>/=: little/big/native byte order for the next fields
+ * spaces are ignored
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param str: const char*, the format string
+ * @returns format_t*, the compiled format
+ */
+format_t *compileFormat(lua_State *L, const char *str) {
+	// there are never more fields than characters
+	format_t *fmt=lua_newuserdata(L, sizeof(format_t)+strlen(str)*sizeof(fmt->fields[0]));
+	fmt->count=0;
+	fmt->size=0;
+	
+	int order=0;
+	for(const char *c=str; *c; c++) {
+		int type=-1, width=0, sgn=TYPE_SIGNED;
+		switch(*c) {
+			case ' ':
+				continue;
+			case '<':
+				order=TYPE_LE;
+				continue;
+			case '>':
+				order=TYPE_BE;
+				continue;
+			case '=':
+				order=0;
+				continue;
+			case 'x':
+				fmt->size++;
+				continue;
+			case 'B':
+				sgn=TYPE_UNSIGNED; // fallthrough
+			case 'b':
+				width=1;
+				break;
+			case 'H':
+				sgn=TYPE_UNSIGNED; // fallthrough
+			case 'h':
+				width=2;
+				break;
+			case 'I':
+				sgn=TYPE_UNSIGNED; // fallthrough
+			case 'i':
+				width=4;
+				if(c[1]>='0'&&c[1]<='9') {
+					width=0;
+					while(c[1]>='0'&&c[1]<='9'&&width<=8) width=width*10+*++c-'0';
+				}
+				break;
+			case 'L':
+				sgn=TYPE_UNSIGNED; // fallthrough
+			case 'l':
+				width=8;
+				break;
+			case 'J':
+				sgn=TYPE_UNSIGNED; // fallthrough
+			case 'j':
+				width=sizeof(lua_Integer);
+				break;
+			case 'f':
+				type=TYPE_FLOAT;
+				break;
+#ifdef TYPE_DOUBLE
+			case 'd':
+				type=TYPE_DOUBLE;
+				break;
+#endif
+			default:
+				luaL_error(L, "invalid format option '%c'", *c);
+		}
+		
+		// integers are stored as the fixed-width type of their size
+		switch(width) {
+			case 1:
+				type=sgn|TYPE_8;
+				break;
+#ifdef TYPE_16
+			case 2:
+				type=sgn|TYPE_16;
+				break;
+#endif
+#ifdef TYPE_32
+			case 4:
+				type=sgn|TYPE_32;
+				break;
+#endif
+#ifdef TYPE_64
+			case 8:
+				type=sgn|TYPE_64;
+				break;
+#endif
+		}
+		if(type==-1) luaL_error(L, "invalid size in format option '%c'", *c);
+		if(typeSizes[type]>1) type|=order;
+		
+		fmt->fields[fmt->count].type=type;
+		fmt->fields[fmt->count].offset=fmt->size;
+		fmt->size+=typeSizes[type];
+		fmt->count++;
+	}
+	return fmt;
+}
+
+/**
+ * @name formatFromArg
+ * reads a format string from Lua arg#arg, and pushes its compiled format on the stack
+ * compiled formats are cached, so each format string is only parsed again once the garbage collector drops it
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @param arg: int, the index of the argument
+ * @returns const format_t*, the compiled format, valid as long as it stays on the stack
+ */
+const format_t *formatFromArg(lua_State *L, int arg) {
+	const char *str=luaL_checkstring(L, arg);
+	arg=lua_absindex(L, arg);
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &formatCacheKey);
+	lua_pushvalue(L, arg);
+	if(lua_rawget(L, -2)!=LUA_TUSERDATA) {
+		lua_pop(L, 1);
+		compileFormat(L, str);
+		lua_pushvalue(L, arg);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_remove(L, -2);
+	return lua_touserdata(L, -1);
+}
+
+/**
+ * @name gatherColumn
+ * copies n values of size bytes, stride bytes apart, into a contiguous array
+ * @param dst: char*, the array
+ * @param src: const char*, the first value
+ * @param n: lua_Integer, the number of values
+ * @param size: int, the size of the values, 1, 2, 4 or 8
+ * @param stride: int, the distance between two values
+ */
+void gatherColumn(char *dst, const char *src, lua_Integer n, int size, int stride) {
+	// constant sizes turn the copies into plain loads and stores
+	switch(size) {
+		case 1:
+			for(lua_Integer k=0; k<n; k++) dst[k]=src[k*stride];
+			break;
+		case 2:
+			for(lua_Integer k=0; k<n; k++) memcpy(dst+k*2, src+k*stride, 2);
+			break;
+		case 4:
+			for(lua_Integer k=0; k<n; k++) memcpy(dst+k*4, src+k*stride, 4);
+			break;
+		case 8:
+			for(lua_Integer k=0; k<n; k++) memcpy(dst+k*8, src+k*stride, 8);
+			break;
+	}
+}
+
+/**
+ * @ref buffer.unpack(buf, fmt, [offset])
+ * @ref buf:unpack(fmt, [offset])
+ * reads the values of a record starting at a byte offset, which defaults to 0, as described by a format like the one of string.pack
+ * the format is made of b/B, h/H, i[n]/I[n], l/L, j/J, f, d for values, x for padding, and </>/= for the byte order
+ * throws if the record doesn't fit in the buffer
+ * @arg1: buffer, buf
+ * @arg2: string, fmt
+ * @arg3: int?, offset
+ * @ret...: number, values
+ * @retn: int, the offset following the record
+ */
+int api_bufferUnpack(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer offset=luaL_optinteger(L, 3, 0);
+	const format_t *fmt=formatFromArg(L, 2);
+	if(offset<0||(lua_Unsigned) offset+fmt->size>(lua_Unsigned) buffer_getSize(buf)) return luaL_argerror(L, 3, "record out of bounds");
+	
+	luaL_checkstack(L, fmt->count+1, "too many values to unpack");
+	const char *ptr=buffer_getCharArray(buf)+offset;
+	for(int k=0; k<fmt->count; k++) pushValueAt(L, ptr+fmt->fields[k].offset, fmt->fields[k].type);
+	lua_pushinteger(L, offset+fmt->size);
+	return fmt->count+1;
+}
+
+/**
+ * @ref buffer.pack(buf, fmt, offset, ...)
+ * @ref buf:pack(fmt, offset, ...)
+ * writes the values of a record starting at a byte offset, as described by a format like for buffer.unpack
+ * padding bytes are left untouched
+ * throws if the record doesn't fit in the buffer
+ * @arg1: buffer, buf
+ * @arg2: string, fmt
+ * @arg3: int, offset
+ * @arg...: number, values
+ * @ret1: int, the offset following the record
+ */
+int api_bufferPack(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer offset=luaL_checkinteger(L, 3);
+	int top=lua_gettop(L);
+	const format_t *fmt=formatFromArg(L, 2);
+	if(offset<0||(lua_Unsigned) offset+fmt->size>(lua_Unsigned) buffer_getSize(buf)) return luaL_argerror(L, 3, "record out of bounds");
+	if(top-3<fmt->count) return luaL_argerror(L, top+1, "missing value for the format");
+	
+	char *ptr=buffer_getCharArray(buf)+offset;
+	for(int k=0; k<fmt->count; k++) storeValueAt(L, ptr+fmt->fields[k].offset, fmt->fields[k].type, k+4);
+	lua_pushinteger(L, offset+fmt->size);
+	return 1;
+}
+
+/**
+ * @ref buffer.unpackmany(buf, fmt, [offset], [n], [columns])
+ * @ref buf:unpackmany(fmt, [offset], [n], [columns])
+ * reads n consecutive records starting at a byte offset, which defaults to 0, into one buffer per field
+ * n defaults to the number of records fitting in the rest of the buffer
+ * the k-th field goes to the k-th buffer of columns, which is resized and set to the native type of the field
+ * missing columns are created, and columns defaults to a new table
+ * throws if the records don't fit in the buffer
+ * @arg1: buffer, buf
+ * @arg2: string, fmt
+ * @arg3: int?, offset
+ * @arg4: int?, n
+ * @arg5: table?, columns
+ * @ret1: table, columns
+ * @ret2: int, the offset following the records
+ */
+int api_bufferUnpackMany(lua_State *L) {
+	buffer_t *buf=bufferFromArg(L);
+	lua_Integer offset=luaL_optinteger(L, 3, 0);
+	if(!lua_isnoneornil(L, 5)) luaL_checktype(L, 5, LUA_TTABLE);
+	lua_settop(L, 5);
+	const format_t *fmt=formatFromArg(L, 2);
+	if(fmt->size==0) return luaL_argerror(L, 2, "must describe at least one byte");
+	if(offset<0||(lua_Unsigned) offset>(lua_Unsigned) buffer_getSize(buf)) return luaL_argerror(L, 3, "out of bounds");
+	lua_Integer n=luaL_optinteger(L, 4, (buffer_getSize(buf)-offset)/fmt->size);
+	if(n<=0) return luaL_argerror(L, 4, "must be positive");
+	if((lua_Unsigned) n>(lua_Unsigned) ((buffer_getSize(buf)-offset)/fmt->size)) return luaL_argerror(L, 4, "records out of bounds");
+	
+	if(lua_isnil(L, 5)) {
+		lua_createtable(L, fmt->count, 0);
+		lua_replace(L, 5);
+	}
+	
+	const char *src=buffer_getCharArray(buf)+offset;
+	for(int k=0; k<fmt->count; k++) {
+		int type=fmt->fields[k].type;
+		int size=typeSizes[type];
+		
+		// reuse the column if there is one
+		lua_rawgeti(L, 5, k+1);
+		buffer_t *col=testBuffer(L, -1);
+		if(col==NULL) {
+			lua_pop(L, 1);
+			col=pushBuffer(L, n*size);
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, 5, k+1);
+		} else {
+			if(!buffer_resize(col, n*size)) return luaL_error(L, "error while resizing buffer");
+			checkInline(L, -1, col);
+		}
+		buffer_setUser(col, (buffer_getUser(col)&~0x3f)|(type&~TYPE_SWAPPED));
+		
+		// values in the other byte order are copied as is, and swapped all at once
+		gatherColumn(buffer_getCharArray(col), src+fmt->fields[k].offset, n, size, fmt->size);
+		if(type&TYPE_SWAPPED) buffer_byteswap(col, 0, n, size);
+		lua_pop(L, 1);
+	}
+	
+	lua_pushvalue(L, 5);
+	lua_pushinteger(L, offset+n*fmt->size);
+	return 2;
+}
+//END records
+
+//BEGIN columns
+/**
+ * @name columnsFromArg
+ * unwraps the columns_t contained in Lua arg1
+ * throws on error
+ * @param L: lua_State, the Lua instance
+ * @returns columns_t*, a pointer to the columns_t
+ */
+columns_t *columnsFromArg(lua_State *L) {
+	return luaL_checkudata(L, 1, COLUMNS_CLASS);
+}
+
+/**
+ * @name checkColumns
+ * checks that no column was resized through the buffer returned by cols:column, so that rows can be accessed safely
+ * throws on error
+ * @param L: lua_State, the Lua instance, with the columns in arg1
+ * @param cols: columns_t*, the columns
+ */
+void checkColumns(lua_State *L, columns_t *cols) {
+	for(int k=0; k<cols->count; k++) {
+		if(buffer_getSize(cols->columns[k].buf)!=(buffer_size_t) (cols->length*cols->columns[k].size)) {
+			lua_getuservalue(L, 1);
+			lua_rawgeti(L, -1, k+1);
+			luaL_error(L, "column '%s' was resized", lua_tostring(L, -1));
+		}
+	}
+}
+
+/**
+ * @name resizeColumns
+ * resizes every column to a given number of rows, which must not be 0
+ * on failure, the columns are put back to their previous length
+ * @param cols: columns_t*, the columns
+ * @param length: lua_Integer, the number of rows
+ * @returns int, nonzero on success, zero on failure
+ */
+int resizeColumns(columns_t *cols, lua_Integer length) {
+	for(int k=0; k<cols->count; k++) {
+		if(!buffer_resize(cols->columns[k].buf, length*cols->columns[k].size)) {
+			// shrinking never moves memory, so the previous sizes can simply be restored
+			while(k-->0) cols->columns[k].buf->size=cols->length*cols->columns[k].size;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @name checkRow
+ * checks that a row only holds numbers, so that writing it can't fail halfway
+ * the row is either a table of named fields, or consecutive stack slots in the order of the columns
+ * throws on error
+ * @param L: lua_State, the Lua instance, with the columns in arg1
+ * @param cols: columns_t*, the columns
+ * @param src: int, the stack index of the table or of the first value
+ * @param named: int, nonzero if src is a table
+ */
+void checkRow(lua_State *L, columns_t *cols, int src, int named) {
+	lua_getuservalue(L, 1);
+	int names=lua_gettop(L);
+	for(int k=0; k<cols->count; k++) {
+		int arg=src+k;
+		if(named) {
+			lua_rawgeti(L, names, k+1);
+			lua_rawget(L, src);
+			arg=lua_gettop(L);
+		}
+		if(!lua_isnoneornil(L, arg)&&!lua_isnumber(L, arg)) {
+			lua_rawgeti(L, names, k+1);
+			luaL_error(L, "value of field '%s' is not a number", lua_tostring(L, -1));
+		}
+		if(named) lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+}
+
+/**
+ * @name storeRow
+ * writes a row checked by checkRow, leaving the fields with missing values untouched
+ * @param L: lua_State, the Lua instance, with the columns in arg1
+ * @param cols: columns_t*, the columns
+ * @param row: lua_Integer, the 0-based index of the row, which must exist
+ * @param src: int, the stack index of the table or of the first value
+ * @param named: int, nonzero if src is a table
+ */
+void storeRow(lua_State *L, columns_t *cols, lua_Integer row, int src, int named) {
+	lua_getuservalue(L, 1);
+	int names=lua_gettop(L);
+	for(int k=0; k<cols->count; k++) {
+		int arg=src+k;
+		if(named) {
+			lua_rawgeti(L, names, k+1);
+			lua_rawget(L, src);
+			arg=lua_gettop(L);
+		}
+		if(!lua_isnoneornil(L, arg)) {
+			storeValueAt(L, buffer_getCharArray(cols->columns[k].buf)+row*cols->columns[k].size, cols->columns[k].type, arg);
+		}
+		if(named) lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+}
+
+/**
+ * @ref buffer.columns(fields, [capacity])
+ * creates an empty set of columns, one buffer per field, all with the same length
+ * fields maps the name of each field to its type, and the columns are ordered by name
+ * capacity is the number of rows to allocate memory for, 16 by default
+ * @arg1: table, fields
+ * @arg2: int?, capacity
+ * @ret1: columns, cols
+ */
+int api_columnsNew(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	buffer_size_t capacity=lua_isnoneornil(L, 2)?16:sizeFromArg(L, 2);
+	
+	// count the fields first, to allocate the struct
+	int count=0;
+	lua_pushnil(L);
+	while(lua_next(L, 1)) {
+		if(lua_type(L, -2)!=LUA_TSTRING) return luaL_argerror(L, 1, "field names must be strings");
+		count++;
+		lua_pop(L, 1);
+	}
+	if(count==0) return luaL_argerror(L, 1, "must have at least one field");
+	
+	lua_settop(L, 1);
+	columns_t *cols=lua_newuserdata(L, sizeof(columns_t)+count*sizeof(cols->columns[0]));
+	cols->length=0;
+	cols->count=0;
+	luaL_setmetatable(L, COLUMNS_CLASS);
+	
+	// the uservalue holds the names in the order of the columns, and maps them to the buffers
+	lua_createtable(L, count, count);
+	lua_pushvalue(L, 3);
+	lua_setuservalue(L, 2);
+	
+	lua_pushnil(L);
+	while(lua_next(L, 1)) {
+		const char *name=lua_tostring(L, 4);
+		int type=-1;
+		if(lua_type(L, 5)==LUA_TNUMBER) {
+			type=lua_tointeger(L, 5);
+			if(!isValidType(type)) type=-1;
+		} else if(lua_type(L, 5)==LUA_TSTRING) type=parseType(lua_tostring(L, 5));
+		if(type==-1) return luaL_error(L, "invalid type for field '%s'", name);
+		if(type&TYPE_SWAPPED) return luaL_error(L, "type of field '%s' must be in native byte order", name);
+		int size=typeSizes[type];
+		if(capacity>BUFFER_SIZE_MAX/size) return luaL_argerror(L, 2, "is too large");
+		
+		// the buffers start empty, with memory for capacity rows
+		buffer_t *buf=pushBuffer(L, capacity*size);
+		buf->size=0;
+		buffer_setUser(buf, type);
+		lua_pushvalue(L, 4);
+		lua_insert(L, -2);
+		lua_rawset(L, 3);
+		
+		// insert the field in order
+		int pos=cols->count;
+		while(pos>0) {
+			lua_rawgeti(L, 3, pos);
+			int cmp=strcmp(lua_tostring(L, -1), name);
+			lua_pop(L, 1);
+			if(cmp<0) break;
+			lua_rawgeti(L, 3, pos);
+			lua_rawseti(L, 3, pos+1);
+			cols->columns[pos]=cols->columns[pos-1];
+			pos--;
+		}
+		lua_pushvalue(L, 4);
+		lua_rawseti(L, 3, pos+1);
+		cols->columns[pos].buf=buf;
+		cols->columns[pos].type=type;
+		cols->columns[pos].size=size;
+		cols->count++;
+		
+		lua_pop(L, 1);
+	}
+	
+	lua_settop(L, 2);
+	return 1;
+}
+
+/**
+ * @ref cols:append(row)
+ * @ref cols:append(...)
+ * adds a row at the end of the columns, given either as a table of named fields or as values in the order of the columns
+ * missing values are set to 0
+ * @arg1: columns, cols
+ * @arg2: table|number..., row
+ * @ret1: int, the index of the row
+ */
+int api_columnsAppend(lua_State *L) {
+	columns_t *cols=columnsFromArg(L);
+	int named=lua_istable(L, 2);
+	checkColumns(L, cols);
+	checkRow(L, cols, 2, named);
+	
+	lua_Integer row=cols->length;
+	if(!resizeColumns(cols, row+1)) return luaL_error(L, "error while resizing columns");
+	cols->length=row+1;
+	for(int k=0; k<cols->count; k++) memset(buffer_getCharArray(cols->columns[k].buf)+row*cols->columns[k].size, 0, cols->columns[k].size);
+	storeRow(L, cols, row, 2, named);
+	
+	lua_pushinteger(L, row+1);
+	return 1;
+}
+
+/**
+ * @ref cols:get(idx, [row])
+ * reads a row into a table of named fields, which is row if given
+ * returns nothing if the row doesn't exist
+ * @arg1: columns, cols
+ * @arg2: int, idx
+ * @arg3: table?, row
+ * @ret1: table, row
+ */
+int api_columnsGet(lua_State *L) {
+	columns_t *cols=columnsFromArg(L);
+	lua_Integer idx=luaL_checkinteger(L, 2)-1;
+	if(idx<0||idx>=cols->length) return 0;
+	checkColumns(L, cols);
+	
+	if(lua_isnoneornil(L, 3)) {
+		lua_settop(L, 2);
+		lua_createtable(L, 0, cols->count);
+	} else {
+		luaL_checktype(L, 3, LUA_TTABLE);
+		lua_settop(L, 3);
+	}
+	
+	lua_getuservalue(L, 1);
+	for(int k=0; k<cols->count; k++) {
+		lua_rawgeti(L, 4, k+1);
+		pushValueAt(L, buffer_getCharArray(cols->columns[k].buf)+idx*cols->columns[k].size, cols->columns[k].type);
+		lua_rawset(L, 3);
+	}
+	lua_settop(L, 3);
+	return 1;
+}
+
+/**
+ * @ref cols:set(idx, row)
+ * @ref cols:set(idx, ...)
+ * writes a row, given either as a table of named fields or as values in the order of the columns
+ * missing values are left untouched, and writing a row that doesn't exist silently fails
+ * @arg1: columns, cols
+ * @arg2: int, idx
+ * @arg3: table|number..., row
+ */
+int api_columnsSet(lua_State *L) {
+	columns_t *cols=columnsFromArg(L);
+	lua_Integer idx=luaL_checkinteger(L, 2)-1;
+	int named=lua_istable(L, 3);
+	checkRow(L, cols, 3, named);
+	if(idx<0||idx>=cols->length) return 0;
+	checkColumns(L, cols);
+	storeRow(L, cols, idx, 3, named);
+	return 0;
+}
+
+/**
+ * @ref cols:column(name)
+ * returns the buffer holding a field, whose length is the number of rows
+ * it can be used with any buffer function, but must not be resized, or the rows can no longer be accessed
+ * @arg1: columns, cols
+ * @arg2: string, name
+ * @ret1: buffer?, column
+ */
+int api_columnsColumn(lua_State *L) {
+	columnsFromArg(L);
+	luaL_checkstring(L, 2);
+	lua_getuservalue(L, 1);
+	lua_pushvalue(L, 2);
+	if(lua_rawget(L, -2)!=LUA_TUSERDATA) return 0;
+	return 1;
+}
+
+/**
+ * @ref cols:names()
+ * returns the names of the fields, in the order of the columns
+ * @arg1: columns, cols
+ * @ret1: table, names
+ */
+int api_columnsNames(lua_State *L) {
+	columns_t *cols=columnsFromArg(L);
+	lua_getuservalue(L, 1);
+	lua_createtable(L, cols->count, 0);
+	for(int k=1; k<=cols->count; k++) {
+		lua_rawgeti(L, -2, k);
+		lua_rawseti(L, -2, k);
+	}
+	return 1;
+}
+
+/**
+ * @ref #cols
+ * @arg1: columns, cols
+ * @ret1: int, the number of rows
+ */
+int meta_columnsLen(lua_State *L) {
+	lua_pushinteger(L, columnsFromArg(L)->length);
+	return 1;
+}
+//END columns
+
+//BEGIN ring buffers
+/**
+ * @ref buffer.ring([capacity])
+ * creates an empty ring buffer, a FIFO of bytes which grows when needed and whose contents are always contiguous
+ * @arg1: int?, capacity
+ * @ret1: ring, ring
+ */
+int api_ringNew(lua_State *L) {
+	buffer_size_t capacity=lua_isnoneornil(L, 1)?4096:sizeFromArg(L, 1);
+	buffer_ring_t *ring=(buffer_ring_t*) lua_newuserdata(L, sizeof(buffer_ring_t));
+	if(!buffer_ringCreateData(ring, capacity, 0)) return luaL_error(L, "failed to allocate ring buffer");
+	luaL_setmetatable(L, RING_CLASS);
+	return 1;
+}
+
+/**
+ * @ref ring:push(data, [i], [j])
+ * adds bytes i to j of a string or a buffer at the end of the ring, growing it if needed
+ * @arg1: ring, ring
+ * @arg2: string|buffer, data
+ * @arg3: int?, i
+ * @arg4: int?, j
+ */
+int api_ringPush(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	const char* data;
+	size_t len;
+	buffer_t *buf=testBuffer(L, 2);
+	if(buf!=NULL) {
+		data=buffer_getPointer(buf);
+		len=buffer_getSize(buf);
+	} else data=luaL_checklstring(L, 2, &len);
+	lua_Integer first;
+	lua_Integer n=rangeFromArgs(L, len, 3, &first);
+	if(n>0&&!buffer_ringPush(ring, data+first, n)) return luaL_error(L, "error while growing ring buffer");
+	return 0;
+}
+
+/**
+ * @ref ring:peek([len])
+ * reads up to len bytes from the start of the ring as a string, without removing them
+ * len defaults to the whole ring
+ * @arg1: ring, ring
+ * @arg2: int?, len
+ * @ret1: string, str
+ */
+int api_ringPeek(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	lua_Integer len=buffer_ringGetLength(ring);
+	lua_Integer n=luaL_optinteger(L, 2, len);
+	if(n<0) n=0;
+	if(n>len) n=len;
+	lua_pushlstring(L, buffer_getPointer(ring), n);
+	return 1;
+}
+
+/**
+ * @ref ring:pop([len])
+ * reads up to len bytes from the start of the ring as a string, and removes them
+ * len defaults to the whole ring
+ * @arg1: ring, ring
+ * @arg2: int?, len
+ * @ret1: string, str
+ */
+int api_ringPop(lua_State *L) {
+	api_ringPeek(L);
+	buffer_ringConsume(ringFromArg(L), lua_rawlen(L, -1));
+	return 1;
+}
+
+/**
+ * @ref ring:consume(len)
+ * removes up to len bytes from the start of the ring
+ * @arg1: ring, ring
+ * @arg2: int, len
+ * @ret1: int, count
+ */
+int api_ringConsume(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	lua_Integer n=luaL_checkinteger(L, 2);
+	lua_pushinteger(L, n>0?buffer_ringConsume(ring, n):0);
+	return 1;
+}
+
+/**
+ * @ref ring:find(sub, [start])
+ * finds the first occurrence of the bytes of a string or buffer in the ring, starting at byte start
+ * @arg1: ring, ring
+ * @arg2: string|buffer, sub
+ * @arg3: int?, start
+ * @ret1: int?, idx
+ */
+int api_ringFind(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	const char* needle;
+	size_t len;
+	char value[16];
+	needleFromArg(L, 2, TYPE_UNSIGNED|TYPE_CHAR, &needle, &len, value);
+	lua_Integer count=buffer_ringGetLength(ring);
+	lua_Integer start=luaL_optinteger(L, 3, 1);
+	if(start<0) start+=count+1;
+	if(start<1) start=1;
+	if(start>count+1) return 0;
+	
+	buffer_size_t found=buffer_find(ring, start-1, needle, len);
+	if(found==BUFFER_NPOS) return 0;
+	lua_pushinteger(L, (lua_Integer) found+1);
+	return 1;
+}
+
+/**
+ * @ref ring:readfrom(file, [len])
+ * reads up to len bytes from a file at the end of the ring, growing it if needed
+ * file is either a file from the io library or a file descriptor
+ * len defaults to the free space of the ring, or to its capacity if it is full
+ * @arg1: ring, ring
+ * @arg2: file|int, file
+ * @arg3: int?, len
+ * @ret1: int?, count
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_ringReadFrom(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	int fd;
+	FILE *file=fileFromArg(L, 2, &fd);
+	buffer_size_t room=buffer_ringGetFree(ring);
+	buffer_size_t n=lua_isnoneornil(L, 3)?(room?room:buffer_ringGetCapacity(ring)):sizeFromArg(L, 3);
+	char* ptr=buffer_ringReserve(ring, n);
+	if(ptr==NULL) return luaL_error(L, "error while growing ring buffer");
+	
+	// read straight into the free space, through a buffer wrapping it
+	buffer_size_t count;
+	if(file!=NULL) {
+		count=fread(ptr, 1, n, file);
+		if(count<n&&ferror(file)) return luaL_fileresult(L, 0, NULL);
+	} else {
+		buffer_t space;
+		buffer_wrapData(&space, ptr, n);
+		count=buffer_readFrom(&space, 0, n, fd, -1);
+		if(count==BUFFER_NPOS) return luaL_fileresult(L, 0, NULL);
+	}
+	buffer_ringCommit(ring, count);
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+/**
+ * @ref ring:writeto(file, [len])
+ * writes up to len bytes from the start of the ring to a file, and removes the bytes written
+ * file is either a file from the io library or a file descriptor
+ * len defaults to the whole ring
+ * @arg1: ring, ring
+ * @arg2: file|int, file
+ * @arg3: int?, len
+ * @ret1: int?, count
+ * @ret2: string?, error
+ * @ret3: int?, errno
+ */
+int api_ringWriteTo(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	int fd;
+	FILE *file=fileFromArg(L, 2, &fd);
+	lua_Integer len=buffer_ringGetLength(ring);
+	lua_Integer n=luaL_optinteger(L, 3, len);
+	if(n<0) n=0;
+	if(n>len) n=len;
+	
+	buffer_size_t count;
+	if(file!=NULL) {
+		count=fwrite(buffer_getPointer(ring), 1, n, file);
+		if(count<(buffer_size_t) n) return luaL_fileresult(L, 0, NULL);
+	} else {
+		count=buffer_writeTo(ring, 0, n, fd, -1);
+		if(count==BUFFER_NPOS) return luaL_fileresult(L, 0, NULL);
+	}
+	buffer_ringConsume(ring, count);
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+/**
+ * @ref ring:getcapacity()
+ * @arg1: ring, ring
+ * @ret1: int, capacity
+ */
+int api_ringGetCapacity(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	lua_pushinteger(L, buffer_ringGetCapacity(ring));
+	return 1;
+}
+
+/**
+ * @name __len
+ * @ref #ring
+ * @arg1: ring, ring
+ * @ret1: int, length
+ */
+int meta_ringLen(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	lua_pushinteger(L, buffer_ringGetLength(ring));
+	return 1;
+}
+
+/**
+ * @name __gc
+ * @arg1: ring, ring
+ */
+int meta_ringGc(lua_State *L) {
+	buffer_ring_t *ring=ringFromArg(L);
+	buffer_destroyData(ring);
+	return 0;
+}
+//END ring buffers
+
+//BEGIN lock-free queues
+/**
+ * @ref buffer.spsc(capacity|queue)
+ * creates a lock-free single-producer single-consumer queue of bytes, or wraps one created by C code, given as a light userdata
+ * Lua only gets the consumer side: the producer is another thread, which must be written in C
+ * a wrapped queue isn't destroyed when collected, and must outlive its Lua object
+ * @arg1: int|lightuserdata, capacity|queue
+ * @ret1: spsc, queue
+ */
+int api_spscNew(lua_State *L) {
+	spscref_t *ref;
+	if(lua_islightuserdata(L, 1)) {
+		ref=(spscref_t*) lua_newuserdata(L, sizeof(spscref_t));
+		ref->queue=lua_touserdata(L, 1);
+		ref->owned=0;
+	} else {
+		buffer_size_t capacity=sizeFromArg(L, 1);
+		ref=(spscref_t*) lua_newuserdata(L, sizeof(spscref_t));
+		ref->queue=buffer_spscCreate(capacity);
+		ref->owned=1;
+		if(ref->queue==NULL) return luaL_error(L, "failed to allocate queue");
+	}
+	luaL_setmetatable(L, SPSC_CLASS);
+	return 1;
+}
+
+/**
+ * @ref queue:pop([len])
+ * reads and removes up to len bytes from the queue as a string, which is empty if the queue is
+ * len defaults to all the bytes available
+ * @arg1: spsc, queue
+ * @arg2: int?, len
+ * @ret1: string, str
+ */
+int api_spscPop(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	buffer_size_t n=lua_isnoneornil(L, 2)?buffer_spscGetLength(queue):sizeFromArg(L, 2);
+	if(n>buffer_spscGetCapacity(queue)) n=buffer_spscGetCapacity(queue);
+	luaL_Buffer b;
+	char* ptr=luaL_buffinitsize(L, &b, n);
+	luaL_pushresultsize(&b, buffer_spscPop(queue, ptr, n));
+	return 1;
+}
+
+/**
+ * @ref queue:popinto(buf, [idx], [len])
+ * reads and removes up to len bytes from the queue into a buffer, starting at byte idx, stopping at the end of the buffer
+ * len defaults to the rest of the buffer
+ * @arg1: spsc, queue
+ * @arg2: buffer, buf
+ * @arg3: int?, idx
+ * @arg4: int?, len
+ * @ret1: int, count
+ */
+int api_spscPopInto(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	buffer_t *buf=bufferAt(L, 2);
+	lua_Integer size=buffer_getSize(buf);
+	lua_Integer idx=luaL_optinteger(L, 3, 1);
+	if(idx<0) idx+=size+1;
+	idx--;
+	if(idx<0||idx>size) idx=size;
+	lua_Integer n=luaL_optinteger(L, 4, size-idx);
+	if(n<0) n=0;
+	if(n>size-idx) n=size-idx;
+	
+	lua_pushinteger(L, buffer_spscPop(queue, buffer_getCharArray(buf)+idx, n));
+	return 1;
+}
+
+/**
+ * @ref queue:consume(len)
+ * removes up to len bytes from the queue
+ * @arg1: spsc, queue
+ * @arg2: int, len
+ * @ret1: int, count
+ */
+int api_spscConsume(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	lua_Integer n=luaL_checkinteger(L, 2);
+	buffer_size_t len=buffer_spscGetLength(queue);
+	if(n<=0) len=0;
+	else if((lua_Unsigned) n<(lua_Unsigned) len) len=n;
+	buffer_spscConsume(queue, len);
+	lua_pushinteger(L, len);
+	return 1;
+}
+
+/**
+ * @ref queue:getcapacity()
+ * @arg1: spsc, queue
+ * @ret1: int, capacity
+ */
+int api_spscGetCapacity(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	lua_pushinteger(L, buffer_spscGetCapacity(queue));
+	return 1;
+}
+
+/**
+ * @ref queue:pointer()
+ * returns the queue as a light userdata, to give it to the C code of the producer
+ * @arg1: spsc, queue
+ * @ret1: lightuserdata, ptr
+ */
+int api_spscPointer(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	lua_pushlightuserdata(L, queue);
+	return 1;
+}
+
+/**
+ * @name __len
+ * @ref #queue
+ * the length is a snapshot, as the producer may be adding bytes
+ * @arg1: spsc, queue
+ * @ret1: int, length
+ */
+int meta_spscLen(lua_State *L) {
+	buffer_spsc_t *queue=spscFromArg(L);
+	lua_pushinteger(L, buffer_spscGetLength(queue));
+	return 1;
+}
+
+/**
+ * @name __gc
+ * @arg1: spsc, queue
+ */
+int meta_spscGc(lua_State *L) {
+	spscref_t *ref=luaL_checkudata(L, 1, SPSC_CLASS);
+	if(ref->owned) buffer_spscDestroy(ref->queue);
+	ref->queue=NULL;
+	return 0;
+}
+//END lock-free queues
+
+//BEGIN metamethods
+/**
+ * @name __index
+ * @ref buf[key]
+ * integer keys read as the type of the buffer without going through buffer.get
+ * @arg1: buffer, buf
+ * @arg2: any, key
+ * @ret: any
+ */
+int meta_index(lua_State *L) {
+	int isint=0;
+	lua_Integer idx=lua_tointegerx(L, 2, &isint);
+	buffer_t *buf=isint?metaBuffer(L, 3):NULL;
+	if(buf!=NULL&&typeSizes[buffer_getUser(buf)&0x3f]) {
+		// fast path: the type is the one of the buffer
+		int type=buffer_getUser(buf)&0x3f;
+		if(idx<1||(lua_Unsigned) idx>(lua_Unsigned) (buffer_getSize(buf)/typeSizes[type])) return 0;
+		pushValue(L, buf, type, idx-1);
+		return 1;
+	} else if(lua_isnumber(L, 2)) return api_bufferGet(L);
+	else {
+		// try getting from the first upvalue (the getter list)
+		lua_settop(L, 3);
+		lua_copy(L, 2, 3);
+		if(lua_gettable(L, lua_upvalueindex(1))) {
+			// call the function
+			lua_remove(L, 2);
+			lua_insert(L, 1);
+			lua_call(L, 1, LUA_MULTRET);
+			return lua_gettop(L);
+		}
+		lua_pop(L, 1);
+		
+		// try getting from the second upvalue (the library)
+		if(lua_gettable(L, lua_upvalueindex(2))) return 1;
+		return 0;
+	}
+}
 
 /**
  * @name __newindex
  * @ref buf[key]=val
+ * integer keys write as the type of the buffer without going through buffer.set
  * @arg1: buffer, buf
  * @arg2: any, key
  * @arg3: any, val
  */
 int meta_newindex(lua_State *L) {
-	if(lua_isnumber(L, 2)) return api_bufferSet(L);
+	int isint=0;
+	lua_Integer idx=lua_tointegerx(L, 2, &isint);
+	buffer_t *buf=isint?metaBuffer(L, 2):NULL;
+	if(buf!=NULL&&typeSizes[buffer_getUser(buf)&0x3f]) {
+		// fast path: the type is the one of the buffer
+		int type=buffer_getUser(buf)&0x3f;
+		if(idx<1||(lua_Unsigned) idx>(lua_Unsigned) (buffer_getSize(buf)/typeSizes[type])) return 0;
+		storeValue(L, buf, type, idx-1, 3);
+		return 0;
+	} else if(lua_isnumber(L, 2)) return api_bufferSet(L);
 	else {
 		// try getting from the first upvalue (the setter list)
 		lua_settop(L, 4);
@@ -843,6 +4818,11 @@ int meta_ipairs(lua_State *L) {
  */
 int meta_gc(lua_State *L) {
 	buffer_t *buf=bufferFromArg(L);
+	if(buffer_getFlags(buf)&BUFFER_VIEW) {
+		// the parent is still alive, as it is only collected after its views
+		lua_getuservalue(L, 1);
+		buffer_unpin(lua_touserdata(L, -1));
+	}
 	buffer_destroyData(buf);
 	return 0;
 }
@@ -885,6 +4865,18 @@ int luaopen_buffer2(lua_State *L) {
 	// create the metatable
 	setupMeta(L);
 	
+	// create the metatable of ring buffers
+	setupRing(L);
+	
+	// create the metatable of queues
+	setupSpsc(L);
+	
+	// create the metatable of pools
+	setupPool(L);
+	
+	// create the metatable of columns
+	setupColumns(L);
+	
 	// return the library
 	return 1;
 }
@@ -898,19 +4890,80 @@ int setupLib(lua_State *L) {
 	static luaL_Reg lib[]={
 		{"new", api_bufferNew},
 		{"calloc", api_bufferCalloc},
+		{"pool", api_bufferPool},
+		{"fromstring", api_bufferFromString},
+		{"mmap", api_bufferMmap},
+		{"sync", api_bufferSync},
+		{"readfile", api_bufferReadFile},
+		{"readfrom", api_bufferReadFrom},
+		{"writeto", api_bufferWriteTo},
+		{"ring", api_ringNew},
+		{"spsc", api_spscNew},
+		{"clone", api_bufferClone},
+		{"copy", api_bufferCopy},
+		{"internalcopy", api_bufferInternalCopy},
+		{"view", api_bufferView},
+		{"find", api_bufferFind},
+		{"findall", api_bufferFindAll},
+		{"sum", api_bufferSum},
+		{"min", api_bufferMin},
+		{"max", api_bufferMax},
+		{"fill", api_bufferFill},
+		{"scale", api_bufferScale},
+		{"add", api_bufferAdd},
+		{"dot", api_bufferDot},
+		{"foreach", api_bufferForeach},
+		{"map", api_bufferMap},
+		{"convert", api_bufferConvert},
+		{"sort", api_bufferSort},
+		{"argsort", api_bufferArgsort},
+		{"bsearch", api_bufferBsearch},
+		{"byteswap", api_bufferByteswap},
+		{"unpack", api_bufferUnpack},
+		{"pack", api_bufferPack},
+		{"unpackmany", api_bufferUnpackMany},
+		{"columns", api_columnsNew},
+		{"readstring", api_bufferReadString},
+		{"writestring", api_bufferWriteString},
 		{"getsize", api_bufferGetSize},
 		{"setsize", api_bufferSetSize},
+		{"getcapacity", api_bufferGetCapacity},
+		{"reserve", api_bufferReserve},
+		{"shrink", api_bufferShrink},
+		{"getgrowth", api_bufferGetGrowth},
+		{"setgrowth", api_bufferSetGrowth},
+		{"getthreads", api_bufferGetThreads},
+		{"setthreads", api_bufferSetThreads},
 		{"getlength", api_bufferGetLength},
 		{"setlength", api_bufferSetLength},
 		{"gettype", api_bufferGetType},
 		{"settype", api_bufferSetType},
 		{"get", api_bufferGet},
 		{"set", api_bufferSet},
+		{"getat", api_bufferGetAt},
+		{"setat", api_bufferSetAt},
+		{"getter", api_bufferGetter},
+		{"setter", api_bufferSetter},
+		{"totable", api_bufferToTable},
+		{"fromtable", api_bufferFromTable},
+		{"setrange", api_bufferSetRange},
 		{"iter", other_iter},
 		{NULL, NULL}
 	};
 	luaL_newlib(L, lib);
 	
+	// create the type name cache, filled as type names are used
+	lua_newtable(L);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &typeCacheKey);
+	
+	// create the format cache, whose entries the garbage collector drops when they aren't in use
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushliteral(L, "v");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &formatCacheKey);
+	
 	// create table with all the types
 	lua_newtable(L);
 	
@@ -961,6 +5014,48 @@ int setupLib(lua_State *L) {
 	lua_setfield(L, -2, "int64");
 #endif
 	
+	// types in a given byte order
+	lua_pushinteger(L, TYPE_FLOAT|TYPE_BE);
+	lua_setfield(L, -2, "befloat");
+	lua_pushinteger(L, TYPE_FLOAT|TYPE_LE);
+	lua_setfield(L, -2, "lefloat");
+#ifdef TYPE_DOUBLE
+	lua_pushinteger(L, TYPE_DOUBLE|TYPE_BE);
+	lua_setfield(L, -2, "bedouble");
+	lua_pushinteger(L, TYPE_DOUBLE|TYPE_LE);
+	lua_setfield(L, -2, "ledouble");
+#endif
+#ifdef TYPE_16
+	lua_pushinteger(L, TYPE_16|TYPE_BE);
+	lua_setfield(L, -2, "be16");
+	lua_pushinteger(L, TYPE_16|TYPE_BE);
+	lua_setfield(L, -2, "beint16");
+	lua_pushinteger(L, TYPE_16|TYPE_LE);
+	lua_setfield(L, -2, "le16");
+	lua_pushinteger(L, TYPE_16|TYPE_LE);
+	lua_setfield(L, -2, "leint16");
+#endif
+#ifdef TYPE_32
+	lua_pushinteger(L, TYPE_32|TYPE_BE);
+	lua_setfield(L, -2, "be32");
+	lua_pushinteger(L, TYPE_32|TYPE_BE);
+	lua_setfield(L, -2, "beint32");
+	lua_pushinteger(L, TYPE_32|TYPE_LE);
+	lua_setfield(L, -2, "le32");
+	lua_pushinteger(L, TYPE_32|TYPE_LE);
+	lua_setfield(L, -2, "leint32");
+#endif
+#ifdef TYPE_64
+	lua_pushinteger(L, TYPE_64|TYPE_BE);
+	lua_setfield(L, -2, "be64");
+	lua_pushinteger(L, TYPE_64|TYPE_BE);
+	lua_setfield(L, -2, "beint64");
+	lua_pushinteger(L, TYPE_64|TYPE_LE);
+	lua_setfield(L, -2, "le64");
+	lua_pushinteger(L, TYPE_64|TYPE_LE);
+	lua_setfield(L, -2, "leint64");
+#endif
+	
 	lua_setfield(L, 1, "types");
 	return 1;
 }
@@ -970,8 +5065,9 @@ int setupLib(lua_State *L) {
  * creates the metatable for buffers
  */
 int setupMeta(lua_State *L) {
-	// create metatable
+	// create metatables
 	luaL_newmetatable(L, BUFFER_CLASS);
+	luaL_newmetatable(L, INLINE_CLASS);
 	
 	// simple methods
 	lua_pushcfunction(L, meta_len);
@@ -985,14 +5081,17 @@ int setupMeta(lua_State *L) {
 	// __index
 	static luaL_Reg getters[]={
 		{"size", api_bufferGetSize},
+		{"capacity", api_bufferGetCapacity},
 		{"length", api_bufferGetLength},
 		{"type", api_bufferGetType},
 		{NULL, NULL}
 	};
+	// the metatables let the fast path recognize buffers
 	luaL_newlib(L, getters);
-	lua_settop(L, lua_gettop(L)+1);
-	lua_copy(L, 1, -1);
-	lua_pushcclosure(L, meta_index, 2);
+	lua_pushvalue(L, 1);
+	lua_pushvalue(L, 2);
+	lua_pushvalue(L, 3);
+	lua_pushcclosure(L, meta_index, 4);
 	lua_setfield(L, 2, "__index");
 	
 	// __newindex
@@ -1003,9 +5102,121 @@ int setupMeta(lua_State *L) {
 		{NULL, NULL}
 	};
 	luaL_newlib(L, setters);
-	lua_pushcclosure(L, meta_newindex, 1);
+	lua_pushvalue(L, 2);
+	lua_pushvalue(L, 3);
+	lua_pushcclosure(L, meta_newindex, 3);
 	lua_setfield(L, 2, "__newindex");
 	
+	// inline buffers share everything but __gc, as their data is collected with them
+	static const char *shared[]={"__len", "__ipairs", "__index", "__newindex", NULL};
+	for(const char **name=shared; *name; name++) {
+		lua_getfield(L, 2, *name);
+		lua_setfield(L, 3, *name);
+	}
+	
+	lua_pop(L, 2);
+	return 0;
+}
+
+/**
+ * @name setupRing
+ * creates the metatable for ring buffers
+ */
+int setupRing(lua_State *L) {
+	// create metatable
+	luaL_newmetatable(L, RING_CLASS);
+	
+	// simple methods
+	lua_pushcfunction(L, meta_ringLen);
+	lua_setfield(L, 2, "__len");
+	lua_pushcfunction(L, meta_ringGc);
+	lua_setfield(L, 2, "__gc");
+	
+	// __index
+	static luaL_Reg methods[]={
+		{"push", api_ringPush},
+		{"peek", api_ringPeek},
+		{"pop", api_ringPop},
+		{"consume", api_ringConsume},
+		{"find", api_ringFind},
+		{"readfrom", api_ringReadFrom},
+		{"writeto", api_ringWriteTo},
+		{"getcapacity", api_ringGetCapacity},
+		{NULL, NULL}
+	};
+	luaL_newlib(L, methods);
+	lua_setfield(L, 2, "__index");
+	
+	lua_pop(L, 1);
+	return 0;
+}
+
+/**
+ * @name setupSpsc
+ * creates the metatable for queues
+ */
+int setupSpsc(lua_State *L) {
+	// create metatable
+	luaL_newmetatable(L, SPSC_CLASS);
+	
+	// simple methods
+	lua_pushcfunction(L, meta_spscLen);
+	lua_setfield(L, 2, "__len");
+	lua_pushcfunction(L, meta_spscGc);
+	lua_setfield(L, 2, "__gc");
+	
+	// __index
+	static luaL_Reg methods[]={
+		{"pop", api_spscPop},
+		{"popinto", api_spscPopInto},
+		{"consume", api_spscConsume},
+		{"getcapacity", api_spscGetCapacity},
+		{"pointer", api_spscPointer},
+		{NULL, NULL}
+	};
+	luaL_newlib(L, methods);
+	lua_setfield(L, 2, "__index");
+	
+	lua_pop(L, 1);
+	return 0;
+}
+
+/**
+ * @name setupPool
+ * creates the metatable for pools
+ */
+int setupPool(lua_State *L) {
+	luaL_newmetatable(L, POOL_CLASS);
+	lua_pushcfunction(L, meta_poolGc);
+	lua_setfield(L, 2, "__gc");
+	lua_pop(L, 1);
+	return 0;
+}
+
+/**
+ * @name setupColumns
+ * creates the metatable for columns
+ */
+int setupColumns(lua_State *L) {
+	// create metatable
+	luaL_newmetatable(L, COLUMNS_CLASS);
+	
+	// simple methods
+	lua_pushcfunction(L, meta_columnsLen);
+	lua_setfield(L, 2, "__len");
+	
+	// __index
+	static luaL_Reg methods[]={
+		{"append", api_columnsAppend},
+		{"get", api_columnsGet},
+		{"set", api_columnsSet},
+		{"column", api_columnsColumn},
+		{"names", api_columnsNames},
+		{NULL, NULL}
+	};
+	luaL_newlib(L, methods);
+	lua_setfield(L, 2, "__index");
+	
 	lua_pop(L, 1);
 	return 0;
 }